@@ -0,0 +1,339 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Microbenchmarks of request and rendering hot paths
+ *
+ * Functions are run against an in memory fixture: one layer with its
+ * storage described by hand, and canned PGresult built with libpq,
+ * so no database is needed. Each operation runs inside the arena,
+ * reset after each one as after a request.
+ * Output is one JSON line by benchmark:
+ *   {"name":..., "iterations":..., "ns_per_op":..., "bytes_per_op":...}
+ * where bytes are those asked to the arena and to libxml2.
+ *
+ * Usage: tinyows_bench [-t seconds] [name ...]
+ * Names select benchmarks by prefix, all are run if none.
+ */
+
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bench.h"
+
+
+static double bench_time = 0.5;        /* seconds by benchmark */
+static char **bench_names = NULL;      /* selected prefixes */
+static int bench_names_count = 0;
+static size_t bench_xml_bytes = 0;     /* asked to libxml2 allocator */
+
+
+/*
+ * libxml2 allocator, counting bytes asked
+ */
+static void *bench_xml_malloc(size_t size)
+{
+  bench_xml_bytes += size;
+  return malloc(size);
+}
+
+
+static void *bench_xml_realloc(void *p, size_t size)
+{
+  bench_xml_bytes += size;
+  return realloc(p, size);
+}
+
+
+static char *bench_xml_strdup(const char *str)
+{
+  char *s;
+  size_t size;
+
+  size = strlen(str) + 1;
+  bench_xml_bytes += size;
+  s = malloc(size);
+  assert(s);
+  memcpy(s, str, size);
+
+  return s;
+}
+
+
+/* Columns of the fixture layer, with a value for canned results */
+static const struct {
+  const char *name;
+  const char *type;
+  const char *value;
+} bench_columns[] = {
+  { "gid",       "int4",            NULL },  /* row number */
+  { "name",      "varchar",         "Route de l'Ecole & Chemin des \"Vignes\"" },
+  { "type",      "varchar",         "secondary" },
+  { "lanes",     "int4",            "2" },
+  { "length",    "float8",          "1234.5678" },
+  { "oneway",    "bool",            "f" },
+  { "updated",   "timestamp",       "2012-03-14 15:09:26" },
+  { "the_geom",  "MULTILINESTRING", NULL }   /* GML or GeoJSON */
+};
+
+#define BENCH_COLUMNS (int) (sizeof(bench_columns) / sizeof(bench_columns[0]))
+
+
+/*
+ * Build the ows fixture: one layer, described as storage fill would do
+ */
+ows *bench_ows()
+{
+  ows_layer *l;
+  buffer *b, *t;
+  ows *o;
+  int i;
+
+  o = ows_init();
+  o->config_file = buffer_from_str("bench");
+  buffer_add_str(o->encoding, OWS_DEFAULT_XML_ENCODING);
+  buffer_add_str(o->db_encoding, OWS_DEFAULT_DB_ENCODING);
+  buffer_add_str(o->online_resource, "http://localhost/cgi-bin/tinyows");
+
+#ifndef _WIN32
+  o->output = fopen("/dev/null", "w");
+#else
+  o->output = fopen("NUL", "w");
+#endif
+  assert(o->output);
+
+  /* Only needed to escape strings, so a connection object is enough */
+  o->pg = PQconnectdb(getenv("BENCH_DSN") ? getenv("BENCH_DSN") : "host=/nonexistent");
+
+  o->layers = ows_layer_list_init();
+  l = ows_layer_init();
+  l->retrievable = l->writable = true;
+  buffer_add_str(l->ns_prefix, "tows");
+  buffer_add_str(l->ns_uri, "http://www.tinyows.org/");
+  l->name = buffer_from_str("http://www.tinyows.org/:roads");
+  l->name_no_uri = buffer_from_str("roads");
+  l->name_prefix = buffer_from_str(BENCH_LAYER);
+  l->srid = list_init();
+  list_add_str(l->srid, "4326");
+
+  buffer_add_str(l->storage->schema, "public");
+  buffer_add_str(l->storage->table, "roads");
+  l->storage->srid = 4326;
+  l->storage->pkey = buffer_from_str("gid");
+  l->storage->pkey_column_number = 0;
+  list_add_str(l->storage->geom_columns, "the_geom");
+
+  for (i = 0 ; i < BENCH_COLUMNS ; i++) {
+    b = buffer_from_str(bench_columns[i].name);
+    t = buffer_from_str(bench_columns[i].type);
+    array_add(l->storage->attributes, b, t);
+    hash_add(l->storage->attributes_type, b, (void *) ows_psql_type_info_from_name(t));
+  }
+
+  ows_layer_list_add(o->layers, l);
+
+  o->request = ows_request_init();
+  o->request->service = WFS;
+  o->request->version = ows_version_init();
+  ows_version_set(o->request->version, 1, 1, 0);
+  o->request->request.wfs = wfs_request_init();
+
+  return o;
+}
+
+
+/*
+ * Build a canned result, as GetFeature SQL would return for the fixture
+ * Geometry is a GML 3 or a GeoJSON multilinestring of 16 points
+ */
+PGresult *bench_result(int rows, bool geojson)
+{
+  PGresAttDesc atts[BENCH_COLUMNS];
+  PGresult *res;
+  buffer *geom;
+  char gid[16];
+  int i, j;
+
+  memset(atts, 0, sizeof(atts));
+  for (j = 0 ; j < BENCH_COLUMNS ; j++) {
+    atts[j].name = (char *) bench_columns[j].name;
+    atts[j].format = 0;
+    atts[j].typlen = -1;
+    atts[j].atttypmod = -1;
+  }
+
+  geom = buffer_init();
+  if (geojson) buffer_add_str(geom, "{\"type\":\"MultiLineString\",\"coordinates\":[[");
+  else buffer_add_str(geom, "<gml:MultiCurve srsName=\"EPSG:4326\"><gml:curveMember>"
+                              "<gml:LineString><gml:posList srsDimension=\"2\">");
+  for (i = 0 ; i < 16 ; i++) {
+    if (geojson) buffer_add_str(geom, i ? ",[" : "[");
+    else if (i) buffer_add(geom, ' ');
+    buffer_add_double(geom, 2.3522219 + i * 0.0001234);
+    buffer_add(geom, geojson ? ',' : ' ');
+    buffer_add_double(geom, 48.856614 - i * 0.0000987);
+    if (geojson) buffer_add(geom, ']');
+  }
+  if (geojson) buffer_add_str(geom, "]]}");
+  else buffer_add_str(geom, "</gml:posList></gml:LineString></gml:curveMember></gml:MultiCurve>");
+
+  res = PQmakeEmptyPGresult(NULL, PGRES_TUPLES_OK);
+  assert(res);
+  PQsetResultAttrs(res, BENCH_COLUMNS, atts);
+
+  for (i = 0 ; i < rows ; i++) {
+    sprintf(gid, "%d", i + 1);
+    for (j = 0 ; j < BENCH_COLUMNS ; j++) {
+      if (!strcmp(bench_columns[j].name, "gid"))
+        PQsetvalue(res, i, j, gid, (int) strlen(gid));
+      else if (!bench_columns[j].value)
+        PQsetvalue(res, i, j, geom->buf, (int) geom->use);
+      else
+        PQsetvalue(res, i, j, (char *) bench_columns[j].value, (int) strlen(bench_columns[j].value));
+    }
+  }
+
+  buffer_free(geom);
+
+  return res;
+}
+
+
+/*
+ * Check if a benchmark is selected on command line
+ */
+static bool bench_selected(const char *name)
+{
+  int i;
+
+  if (!bench_names_count) return true;
+
+  for (i = 0 ; i < bench_names_count ; i++)
+    if (!strncmp(name, bench_names[i], strlen(bench_names[i]))) return true;
+
+  return false;
+}
+
+
+/*
+ * Run n operations, each one as a request: arena is reset after it
+ */
+static double bench_loop(ows * o, bench_fn fn, void *data, unsigned long n)
+{
+  unsigned long i;
+  double start;
+
+  start = ows_time();
+  for (i = 0 ; i < n ; i++) {
+    fn(o, data);
+    arena_reset(o->arena);
+  }
+
+  return ows_time() - start;
+}
+
+
+/*
+ * Time a benchmark and print its result
+ * Iterations are first doubled until a run takes a tenth of the
+ * time asked, then scaled to fill it
+ */
+void bench_run(ows * o, const char *name, bench_fn fn, void *data)
+{
+  unsigned long n;
+  size_t arena_bytes, xml_bytes;
+  double elapsed;
+
+  assert(o && name && fn);
+
+  if (!bench_selected(name)) return;
+
+  arena_use(o->arena);
+
+  for (n = 1 ; ; n *= 2) {
+    elapsed = bench_loop(o, fn, data, n);
+    if (elapsed >= bench_time / 10.0 || n >= (1UL << 30)) break;
+  }
+  if (elapsed > 0.0) n = (unsigned long) (n * bench_time / elapsed);
+  if (n < 1) n = 1;
+
+  arena_bytes = o->arena->allocated;
+  xml_bytes = bench_xml_bytes;
+  elapsed = bench_loop(o, fn, data, n);
+  arena_bytes = o->arena->allocated - arena_bytes;
+  xml_bytes = bench_xml_bytes - xml_bytes;
+
+  arena_use(NULL);
+
+  fprintf(stdout, "{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.1f,\"bytes_per_op\":%.1f}\n",
+          name, n, elapsed * 1e9 / n, (double) (arena_bytes + xml_bytes) / n);
+  fflush(stdout);
+}
+
+
+int main(int argc, char *argv[])
+{
+  ows *o;
+  int i;
+
+  for (i = 1 ; i < argc ; i++) {
+    if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      bench_time = atof(argv[++i]);
+      if (bench_time <= 0.0) bench_time = 0.5;
+    } else {
+      bench_names = argv + i;
+      bench_names_count = argc - i;
+      break;
+    }
+  }
+
+  xmlMemSetup(free, bench_xml_malloc, bench_xml_realloc, bench_xml_strdup);
+  LIBXML_TEST_VERSION
+  xmlInitParser();
+
+  o = bench_ows();
+
+  bench_buffer(o);
+  bench_cgi(o);
+  bench_fe(o);
+  bench_render(o);
+
+  fclose(o->output);
+  o->output = stdout;
+  ows_free(o);
+  xmlCleanupParser();
+
+  return EXIT_SUCCESS;
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
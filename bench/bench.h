@@ -0,0 +1,54 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Microbenchmarks of request and rendering hot paths
+ * See bench.c
+ */
+
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../src/ows/ows.h"
+
+
+#define BENCH_LAYER "tows:roads"   /* the fixture layer, prefixed name */
+
+typedef void (*bench_fn) (ows * o, void *data);
+
+ows *bench_ows ();
+PGresult *bench_result (int rows, bool geojson);
+void bench_run (ows * o, const char *name, bench_fn fn, void *data);
+
+void bench_buffer (ows * o);
+void bench_cgi (ows * o);
+void bench_fe (ows * o);
+void bench_render (ows * o);
+
+#endif /* BENCH_H */
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -0,0 +1,130 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Buffer operations, as used by SQL and output building
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bench.h"
+
+
+static const char *bench_text = "Route de l'Ecole & Chemin des \"Vignes\" <sud>\tvers la gare";
+
+
+static void bench_buffer_add_str(ows * o, void *data)
+{
+  buffer *b;
+  int i;
+
+  b = buffer_init();
+  for (i = 0 ; i < 64 ; i++) buffer_add_str(b, "\"name\" = 'value' AND ");
+  buffer_free(b);
+}
+
+
+static void bench_buffer_add_int(ows * o, void *data)
+{
+  buffer *b;
+  int i;
+
+  b = buffer_init();
+  for (i = 0 ; i < 64 ; i++) {
+    buffer_add_int(b, 123456 + i);
+    buffer_add(b, ',');
+  }
+  buffer_free(b);
+}
+
+
+static void bench_buffer_add_double(ows * o, void *data)
+{
+  buffer *b;
+  int i;
+
+  b = buffer_init();
+  for (i = 0 ; i < 64 ; i++) {
+    buffer_add_double(b, 2.3522219 + i * 0.0001234);
+    buffer_add(b, ' ');
+  }
+  buffer_free(b);
+}
+
+
+static void bench_buffer_xml_entities(ows * o, void *data)
+{
+  buffer *b;
+  int i;
+
+  b = buffer_init();
+  for (i = 0 ; i < 16 ; i++) buffer_add_xml_entities(b, bench_text);
+  buffer_free(b);
+}
+
+
+static void bench_buffer_json_str(ows * o, void *data)
+{
+  buffer *b;
+  int i;
+
+  b = buffer_init();
+  for (i = 0 ; i < 16 ; i++) buffer_add_json_str(b, bench_text);
+  buffer_free(b);
+}
+
+
+static void bench_buffer_explode(ows * o, void *data)
+{
+  list *l;
+
+  l = list_explode(',', (buffer *) data);
+  list_free(l);
+}
+
+
+void bench_buffer(ows * o)
+{
+  buffer *b;
+
+  assert(o);
+
+  bench_run(o, "buffer_add_str", bench_buffer_add_str, NULL);
+  bench_run(o, "buffer_add_int", bench_buffer_add_int, NULL);
+  bench_run(o, "buffer_add_double", bench_buffer_add_double, NULL);
+  bench_run(o, "buffer_add_xml_entities", bench_buffer_xml_entities, NULL);
+  bench_run(o, "buffer_add_json_str", bench_buffer_json_str, NULL);
+
+  b = buffer_from_str("gid,name,type,lanes,length,oneway,updated,the_geom");
+  bench_run(o, "list_explode", bench_buffer_explode, b);
+  buffer_free(b);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
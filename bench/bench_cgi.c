@@ -0,0 +1,108 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Request parsing, KVP and XML
+ * Query is parsed in place, so each operation first copies it
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bench.h"
+
+
+static const char *bench_kvp =
+  "SERVICE=WFS&VERSION=1.1.0&REQUEST=GetFeature&TYPENAME=tows:roads"
+  "&PROPERTYNAME=name,type,the_geom&MAXFEATURES=500&OUTPUTFORMAT=text/xml;%20subtype=gml/3.1.1"
+  "&BBOX=2.30,48.80,2.40,48.90,EPSG:4326";
+
+static const char *bench_kvp_filter =
+  "SERVICE=WFS&VERSION=1.1.0&REQUEST=GetFeature&TYPENAME=tows:roads"
+  "&FILTER=%3CFilter%20xmlns%3D%22http%3A%2F%2Fwww.opengis.net%2Fogc%22%3E%3CAnd%3E"
+  "%3CPropertyIsEqualTo%3E%3CPropertyName%3Etype%3C%2FPropertyName%3E"
+  "%3CLiteral%3Esecondary%3C%2FLiteral%3E%3C%2FPropertyIsEqualTo%3E"
+  "%3CPropertyIsGreaterThan%3E%3CPropertyName%3Elanes%3C%2FPropertyName%3E"
+  "%3CLiteral%3E1%3C%2FLiteral%3E%3C%2FPropertyIsGreaterThan%3E%3C%2FAnd%3E%3C%2FFilter%3E";
+
+static const char *bench_xml =
+  "<?xml version=\"1.0\"?>\n"
+  "<wfs:GetFeature service=\"WFS\" version=\"1.1.0\" maxFeatures=\"500\"\n"
+  "  xmlns:wfs=\"http://www.opengis.net/wfs\" xmlns:ogc=\"http://www.opengis.net/ogc\"\n"
+  "  xmlns:gml=\"http://www.opengis.net/gml\" xmlns:tows=\"http://www.tinyows.org/\">\n"
+  " <wfs:Query typeName=\"tows:roads\">\n"
+  "  <wfs:PropertyName>tows:name</wfs:PropertyName>\n"
+  "  <wfs:PropertyName>tows:the_geom</wfs:PropertyName>\n"
+  "  <ogc:Filter>\n"
+  "   <ogc:And>\n"
+  "    <ogc:BBOX><ogc:PropertyName>the_geom</ogc:PropertyName>\n"
+  "     <gml:Envelope><gml:lowerCorner>2.30 48.80</gml:lowerCorner>"
+  "<gml:upperCorner>2.40 48.90</gml:upperCorner></gml:Envelope></ogc:BBOX>\n"
+  "    <ogc:PropertyIsLike wildCard=\"*\" singleChar=\"?\" escapeChar=\"\\\">\n"
+  "     <ogc:PropertyName>name</ogc:PropertyName><ogc:Literal>Route*</ogc:Literal>\n"
+  "    </ogc:PropertyIsLike>\n"
+  "   </ogc:And>\n"
+  "  </ogc:Filter>\n"
+  " </wfs:Query>\n"
+  "</wfs:GetFeature>\n";
+
+
+static void bench_cgi_kvp(ows * o, void *data)
+{
+  char *query;
+
+  query = arena_malloc(strlen(data) + 1);
+  strcpy(query, data);
+  cgi_parse_kvp(o, query);
+}
+
+
+static void bench_cgi_xml(ows * o, void *data)
+{
+  char *query;
+
+  query = arena_malloc(strlen(data) + 1);
+  strcpy(query, data);
+  cgi_parse_xml(o, query);
+
+  xmlFreeDoc(o->request->doc);
+  o->request->doc = NULL;
+}
+
+
+void bench_cgi(ows * o)
+{
+  assert(o);
+
+  bench_run(o, "cgi_parse_kvp", bench_cgi_kvp, (void *) bench_kvp);
+  bench_run(o, "cgi_parse_kvp_filter", bench_cgi_kvp, (void *) bench_kvp_filter);
+  bench_run(o, "cgi_parse_xml", bench_cgi_xml, (void *) bench_xml);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -0,0 +1,135 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Filter Encoding to SQL, for representative filters
+ * Each one is run with the compiled filter cache, then without it
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bench.h"
+
+
+#define BENCH_FE_NS "<Filter xmlns=\"http://www.opengis.net/ogc\" xmlns:gml=\"http://www.opengis.net/gml\">"
+
+static const struct {
+  const char *name;
+  const char *filter;
+} bench_filters[] = {
+  { "equal",
+    BENCH_FE_NS "<PropertyIsEqualTo><PropertyName>type</PropertyName>"
+    "<Literal>secondary</Literal></PropertyIsEqualTo></Filter>" },
+  { "and_between_like",
+    BENCH_FE_NS "<And><PropertyIsBetween><PropertyName>lanes</PropertyName>"
+    "<LowerBoundary><Literal>1</Literal></LowerBoundary>"
+    "<UpperBoundary><Literal>4</Literal></UpperBoundary></PropertyIsBetween>"
+    "<PropertyIsLike wildCard=\"*\" singleChar=\"?\" escapeChar=\"!\">"
+    "<PropertyName>name</PropertyName><Literal>Route*</Literal></PropertyIsLike></And></Filter>" },
+  { "bbox",
+    BENCH_FE_NS "<BBOX><PropertyName>the_geom</PropertyName><gml:Envelope>"
+    "<gml:lowerCorner>2.30 48.80</gml:lowerCorner><gml:upperCorner>2.40 48.90</gml:upperCorner>"
+    "</gml:Envelope></BBOX></Filter>" },
+  { "bbox_and_or_not",
+    BENCH_FE_NS "<And><BBOX><PropertyName>the_geom</PropertyName><gml:Envelope>"
+    "<gml:lowerCorner>2.30 48.80</gml:lowerCorner><gml:upperCorner>2.40 48.90</gml:upperCorner>"
+    "</gml:Envelope></BBOX><Or><PropertyIsEqualTo><PropertyName>type</PropertyName>"
+    "<Literal>primary</Literal></PropertyIsEqualTo><PropertyIsEqualTo><PropertyName>type</PropertyName>"
+    "<Literal>secondary</Literal></PropertyIsEqualTo></Or><Not><PropertyIsLessThan>"
+    "<PropertyName>length</PropertyName><Literal>10.5</Literal></PropertyIsLessThan></Not></And></Filter>" },
+  { "feature_id",
+    BENCH_FE_NS "<FeatureId fid=\"roads.1\"/><FeatureId fid=\"roads.2\"/><FeatureId fid=\"roads.3\"/>"
+    "<FeatureId fid=\"roads.4\"/><FeatureId fid=\"roads.5\"/></Filter>" }
+};
+
+#define BENCH_FILTERS (int) (sizeof(bench_filters) / sizeof(bench_filters[0]))
+
+
+typedef struct Bench_fe {
+  buffer *typename;
+  buffer *filter;
+} bench_fe_data;
+
+
+static void bench_fe_filter(ows * o, void *data)
+{
+  bench_fe_data *d;
+  filter_encoding *fe;
+
+  d = data;
+  fe = filter_encoding_init();
+  fe = fe_filter(o, fe, d->typename, d->filter);
+  filter_encoding_free(fe);
+}
+
+
+void bench_fe(ows * o)
+{
+  bench_fe_data d;
+  filter_encoding *fe;
+  char name[64];
+  size_t cache_size;
+  int i;
+
+  assert(o);
+
+  d.typename = buffer_from_str(BENCH_LAYER);
+  cache_size = o->filter_cache_size;
+
+  for (i = 0 ; i < BENCH_FILTERS ; i++) {
+    d.filter = buffer_from_str(bench_filters[i].filter);
+
+    /* Filter must compile, else we would time the error path */
+    fe = filter_encoding_init();
+    fe = fe_filter(o, fe, d.typename, d.filter);
+    if (fe->error_code != FE_NO_ERROR) {
+      fprintf(stderr, "fe_filter/%s: filter error %d\n", bench_filters[i].name, fe->error_code);
+      filter_encoding_free(fe);
+      buffer_free(d.filter);
+      continue;
+    }
+    filter_encoding_free(fe);
+
+    o->filter_cache_size = cache_size;
+    sprintf(name, "fe_filter/%s", bench_filters[i].name);
+    bench_run(o, name, bench_fe_filter, &d);
+
+    o->filter_cache_size = 0;
+    sprintf(name, "fe_filter_nocache/%s", bench_filters[i].name);
+    bench_run(o, name, bench_fe_filter, &d);
+
+    buffer_free(d.filter);
+  }
+
+  o->filter_cache_size = cache_size;
+  buffer_free(d.typename);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
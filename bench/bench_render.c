@@ -0,0 +1,95 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Feature rendering, GML and GeoJSON, from canned results of 100 rows
+ * Output goes to the null device
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bench.h"
+
+
+#define BENCH_ROWS 100
+
+
+typedef struct Bench_render {
+  buffer *layer_name;
+  PGresult *res;
+} bench_render_data;
+
+
+static void bench_render_gml(ows * o, void *data)
+{
+  bench_render_data *d;
+
+  d = data;
+  wfs_gml_feature_member(o, o->request->request.wfs, d->layer_name, NULL, d->res);
+}
+
+
+static void bench_render_geojson(ows * o, void *data)
+{
+  bench_render_data *d;
+
+  d = data;
+  wfs_geojson_feature_member(o, d->layer_name, d->res);
+}
+
+
+void bench_render(ows * o)
+{
+  bench_render_data d;
+  enum wfs_format format;
+  buffer *layer;
+
+  assert(o);
+
+  layer = buffer_from_str(BENCH_LAYER);
+  d.layer_name = ows_layer_prefix_to_uri(o->layers, layer);
+  buffer_free(layer);
+  format = o->request->request.wfs->format;
+
+  d.res = bench_result(BENCH_ROWS, false);
+  o->request->request.wfs->format = WFS_GML311;
+  bench_run(o, "wfs_gml_feature_member/gml3", bench_render_gml, &d);
+  o->request->request.wfs->format = WFS_GML212;
+  bench_run(o, "wfs_gml_feature_member/gml2", bench_render_gml, &d);
+  PQclear(d.res);
+
+  d.res = bench_result(BENCH_ROWS, true);
+  bench_run(o, "wfs_geojson_feature_member", bench_render_geojson, &d);
+  PQclear(d.res);
+
+  o->request->request.wfs->format = format;
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
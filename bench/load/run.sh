@@ -0,0 +1,211 @@
+#!/bin/sh
+
+#
+# Drive WFS workloads against tinyows, on the dataset of bench/load/setup.sh
+# Use 'make bench-load' to do so, e.g: make bench-load BENCH="bbox_gml hits"
+#
+# Each scenario prints one JSON line with requests, errors, throughput,
+# p50/p99 latency and peak RSS.
+# Requests are run as CGI processes of TINYOWS binary (so latency includes
+# process start and config load, as CGI deployment does), or sent to a
+# running server when TINYOWS_URL is set (then RSS is read from TINYOWS_PID).
+# update and delete work on features added by insert, so dataset is left
+# unchanged once the three ran.
+#
+
+TINYOWS=${TINYOWS:-./tinyows}
+TINYOWS_CONFIG_FILE=${TINYOWS_CONFIG_FILE:-bench/load/tinyows.xml}
+ROWS=${ROWS:-10000}
+LAYER=${LAYER:-bench_point}
+REQUESTS=${REQUESTS:-200}
+CONCURRENCY=${CONCURRENCY:-1}
+BBOX_SIZE=${BBOX_SIZE:-0.5}
+MAXFEATURES=${MAXFEATURES:-0}
+SEED=${SEED:-42}
+SCENARIOS=${*:-"capabilities bbox_gml bbox_geojson hits featureid mixed insert update delete"}
+export TINYOWS_CONFIG_FILE
+
+tmp=${TMPDIR:-/tmp}/tinyows_load.$$
+trap 'rm -rf $tmp' 0 1 2 15
+mkdir -p $tmp || exit 1
+
+if [ -z "$TINYOWS_URL" ]; then
+	if [ ! -x $TINYOWS ]; then
+		echo "No tinyows binary founded, try to run 'make' before !"
+		exit 1
+	fi
+	if [ ! -f $TINYOWS_CONFIG_FILE ]; then
+		echo "No $TINYOWS_CONFIG_FILE, try to run 'make install-bench' before !"
+		exit 1
+	fi
+fi
+
+# Peak RSS of each CGI process, when GNU time is there
+rss_time=
+if [ -z "$TINYOWS_URL" ] && /usr/bin/time -f %M true > /dev/null 2>&1; then
+	rss_time=/usr/bin/time
+fi
+
+
+#
+# Write request list of a scenario, one per line:
+#   GET query_string
+#   POST body_file content_length
+#
+generate()
+{
+	awk -v scenario=$1 -v n=$REQUESTS -v rows=$ROWS -v layer=$LAYER \
+	    -v size=$BBOX_SIZE -v maxf=$MAXFEATURES -v seed=$SEED \
+	    -v fids=$tmp/fids -v dir=$tmp '
+
+	function bbox(  x, y) {
+		x = -5 + rand() * 14
+		y = 42 + rand() * 9
+		return sprintf("%.4f,%.4f,%.4f,%.4f,EPSG:4326", x, y, x + size, y + size)
+	}
+
+	function get(query) {
+		print "GET SERVICE=WFS&VERSION=1.1.0&" query
+	}
+
+	function post(body,  file) {
+		file = dir "/body." i
+		printf "%s", body > file
+		close(file)
+		print "POST " file " " length(body)
+	}
+
+	function geometry(  x, y) {
+		x = -5 + rand() * 14
+		y = 42 + rand() * 9
+		if (layer ~ /line/)
+			return sprintf("<gml:LineString srsName=\"EPSG:4326\"><gml:posList>%.5f %.5f %.5f %.5f</gml:posList></gml:LineString>", x, y, x + 0.01, y + 0.01)
+		if (layer ~ /polygon/)
+			return sprintf("<gml:Polygon srsName=\"EPSG:4326\"><gml:exterior><gml:LinearRing><gml:posList>%.5f %.5f %.5f %.5f %.5f %.5f %.5f %.5f</gml:posList></gml:LinearRing></gml:exterior></gml:Polygon>", x, y, x + 0.01, y, x, y + 0.01, x, y)
+		return sprintf("<gml:Point srsName=\"EPSG:4326\"><gml:pos>%.5f %.5f</gml:pos></gml:Point>", x, y)
+	}
+
+	BEGIN {
+		srand(seed)
+		feature = "REQUEST=GetFeature&TYPENAME=tows:" layer
+		if (maxf > 0) feature = feature "&MAXFEATURES=" maxf
+		tx = "<wfs:Transaction service=\"WFS\" version=\"1.1.0\"" \
+		     " xmlns:wfs=\"http://www.opengis.net/wfs\" xmlns:ogc=\"http://www.opengis.net/ogc\"" \
+		     " xmlns:gml=\"http://www.opengis.net/gml\" xmlns:tows=\"http://www.tinyows.org/\">"
+
+		# update and delete use features added by insert
+		if (scenario == "update" || scenario == "delete") {
+			while ((getline line < fids) > 0) id[nid++] = line
+			if (scenario == "delete" && n > nid) n = nid
+			if (!nid) n = 0
+		}
+
+		for (i = 0 ; i < n ; i++) {
+			s = scenario
+			if (s == "mixed") {
+				r = rand()
+				s = r < 0.05 ? "capabilities" : r < 0.45 ? "bbox_gml" : r < 0.75 ? "bbox_geojson" : r < 0.85 ? "hits" : "featureid"
+			}
+
+			if (s == "capabilities")
+				get("REQUEST=GetCapabilities")
+			else if (s == "bbox_gml")
+				get(feature "&OUTPUTFORMAT=GML3&BBOX=" bbox())
+			else if (s == "bbox_geojson")
+				get(feature "&OUTPUTFORMAT=application/json&BBOX=" bbox())
+			else if (s == "hits")
+				get(feature "&RESULTTYPE=hits&BBOX=" bbox())
+			else if (s == "featureid")
+				get("REQUEST=GetFeature&FEATUREID=" layer "." (1 + int(rand() * rows)))
+			else if (s == "insert")
+				post(tx "<wfs:Insert><tows:" layer "><tows:name>bench insert</tows:name>" \
+				     "<tows:category>" (i % 16) "</tows:category><tows:value>" rand() * 1000 "</tows:value>" \
+				     "<tows:the_geom>" geometry() "</tows:the_geom></tows:" layer "></wfs:Insert></wfs:Transaction>")
+			else if (s == "update")
+				post(tx "<wfs:Update typeName=\"tows:" layer "\"><wfs:Property><wfs:Name>value</wfs:Name>" \
+				     "<wfs:Value>" rand() * 1000 "</wfs:Value></wfs:Property>" \
+				     "<ogc:Filter><ogc:FeatureId fid=\"" id[i % nid] "\"/></ogc:Filter></wfs:Update></wfs:Transaction>")
+			else if (s == "delete")
+				post(tx "<wfs:Delete typeName=\"tows:" layer "\">" \
+				     "<ogc:Filter><ogc:FeatureId fid=\"" id[i] "\"/></ogc:Filter></wfs:Delete></wfs:Transaction>")
+			else {
+				print "Unknown scenario: " scenario > "/dev/stderr"
+				exit 1
+			}
+		}
+	}' > $tmp/requests
+}
+
+
+#
+# Run a request list, one line per request:
+#   latency_ns rss_kb error
+#
+worker()
+{
+	out=$2.out
+
+	while read method arg length; do
+		rss=0
+		start=`date +%s%N`
+
+		if [ -n "$TINYOWS_URL" ] && [ $method = GET ]; then
+			curl -s -o $out "$TINYOWS_URL?$arg"
+		elif [ -n "$TINYOWS_URL" ]; then
+			curl -s -o $out -H "Content-Type: text/xml" --data-binary @$arg "$TINYOWS_URL"
+		elif [ $method = GET ]; then
+			REQUEST_METHOD=GET QUERY_STRING=$arg \
+				${rss_time:+$rss_time -f %M -o $2.rss} $TINYOWS > $out
+		else
+			REQUEST_METHOD=POST CONTENT_TYPE=text/xml CONTENT_LENGTH=$length \
+				${rss_time:+$rss_time -f %M -o $2.rss} $TINYOWS < $arg > $out
+		fi
+
+		end=`date +%s%N`
+		[ -n "$rss_time" ] && rss=`tail -n 1 $2.rss`
+
+		error=0
+		if [ ! -s $out ] || grep -q "ExceptionReport" $out; then
+			error=1
+		fi
+		grep -o 'fid="[^"]*"' $out | sed 's/fid="\(.*\)"/\1/' >> $2.fids
+
+		echo `expr $end - $start` $rss $error
+	done < $1 > $2.lat
+}
+
+
+for scenario in $SCENARIOS; do
+	generate $scenario || exit 1
+	rm -f $tmp/w.*
+
+	# Round robin split of requests between workers
+	awk -v c=$CONCURRENCY -v p=$tmp/w. '{ print > (p (NR % c) ".req") }' $tmp/requests
+
+	start=`date +%s%N`
+	for req in $tmp/w.*.req; do
+		[ -f $req ] && worker $req ${req%.req} &
+	done
+	wait
+	end=`date +%s%N`
+
+	if [ $scenario = insert ]; then
+		cat $tmp/w.*.fids > $tmp/fids 2> /dev/null
+	fi
+
+	rss=
+	if [ -n "$TINYOWS_PID" ]; then
+		rss=`awk '/^VmHWM:/ { print $2 }' /proc/$TINYOWS_PID/status 2> /dev/null`
+	fi
+
+	cat $tmp/w.*.lat 2> /dev/null | sort -n | awk -v name=$scenario -v c=$CONCURRENCY \
+	    -v wall=`expr $end - $start` -v rss=$rss '
+		{ lat[NR] = $1; if ($2 > max) max = $2; errors += $3 }
+		END {
+			if (!NR) { printf "{\"scenario\":\"%s\",\"requests\":0}\n", name; exit }
+			if (rss == "") rss = max ? max : "null"
+			printf "{\"scenario\":\"%s\",\"requests\":%d,\"errors\":%d,\"concurrency\":%d,", name, NR, errors, c
+			printf "\"rps\":%.1f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"rss_kb\":%s}\n", NR * 1e9 / wall,
+			       lat[int((NR * 50 + 99) / 100)] / 1e6, lat[int((NR * 99 + 99) / 100)] / 1e6, rss
+		}'
+done
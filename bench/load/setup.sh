@@ -0,0 +1,133 @@
+#!/bin/sh
+
+#
+# Load the benchmark dataset into PostGIS and write its tinyows.xml
+# Use 'make install-bench' to do so, e.g: make install-bench ROWS=1000000
+#
+# demo/ shapefiles are imported as is, and their boundaries are used as
+# seeds to spread synthetic point, line and polygon layers of ROWS rows
+# (10^4 to 10^7). Random generator is seeded, so a dataset is the same
+# from one run to another.
+#
+# Connection is taken from usual libpq environment variables.
+# Needs PostGIS >= 2.0 (CREATE EXTENSION) and shp2pgsql.
+#
+
+PGBIN=${PGBIN:-`pg_config --bindir`}
+SHP2PGSQL=${SHP2PGSQL:-shp2pgsql}
+PGHOST=${PGHOST:-127.0.0.1}
+PGPORT=${PGPORT:-5432}
+PGUSER=${PGUSER:-postgres}
+PGPASSWORD=${PGPASSWORD:-postgres}
+DB=${DB:-tinyows_bench}
+ROWS=${ROWS:-10000}
+CONFIG=${CONFIG:-bench/load/tinyows.xml}
+export PGHOST PGPORT PGUSER PGPASSWORD
+
+case $ROWS in
+	''|*[!0-9]*) echo "ROWS must be a number of rows, not '$ROWS'" && exit 1;;
+esac
+
+if [ ! -f demo/world.shp ]; then
+	echo "Launch this script from tinyows root dir (make install-bench)"
+	exit 1
+fi
+
+if ! command -v $SHP2PGSQL > /dev/null; then
+	echo "No shp2pgsql found, set SHP2PGSQL=/path/to/shp2pgsql"
+	exit 1
+fi
+
+PSQL="$PGBIN/psql -q -X -v ON_ERROR_STOP=1 $DB"
+
+
+echo "Create Spatial Database: $DB"
+$PGBIN/dropdb $DB > /dev/null 2> /dev/null
+$PGBIN/createdb $DB || exit 1
+echo "CREATE EXTENSION postgis;" | $PSQL || exit 1
+
+echo "Import seed data: world"
+$SHP2PGSQL -s 4326 -I demo/world.shp world 2> /dev/null | $PSQL > /dev/null || exit 1
+
+echo "Import seed data: france"
+$SHP2PGSQL -s 27582 -I -W latin1 demo/france.shp france 2> /dev/null | $PSQL > /dev/null || exit 1
+
+
+echo "Generate layers: bench_point, bench_line, bench_polygon ($ROWS rows)"
+$PSQL -v rows=$ROWS <<EOF || exit 1
+SELECT setseed(0.42);
+
+-- Seed boxes: every country and every french department
+CREATE TEMP TABLE seed AS
+  SELECT row_number() OVER () - 1 AS id, e FROM (
+    SELECT box2d(the_geom) AS e FROM world
+    UNION ALL
+    SELECT box2d(ST_Transform(the_geom, 4326)) FROM france) AS s;
+
+-- One random position per row, inside the box of a seed
+CREATE TEMP TABLE origin AS
+  SELECT i, ST_XMin(e) + random() * (ST_XMax(e) - ST_XMin(e)) AS x,
+            ST_YMin(e) + random() * (ST_YMax(e) - ST_YMin(e)) AS y
+    FROM generate_series(1, :rows) AS i
+    JOIN seed ON seed.id = i % (SELECT count(*) FROM seed);
+
+CREATE TABLE bench_point (gid serial PRIMARY KEY, name varchar(64), category int4,
+                          value float8, updated timestamp, the_geom geometry(Point, 4326));
+INSERT INTO bench_point (name, category, value, updated, the_geom)
+  SELECT 'point ' || i, i % 16, random() * 1000, '2012-01-01'::timestamp + (i % 3650) * interval '1 day',
+         ST_SetSRID(ST_MakePoint(x, y), 4326)
+    FROM origin ORDER BY i;
+
+-- 8 vertices random walk
+CREATE TABLE bench_line (gid serial PRIMARY KEY, name varchar(64), category int4,
+                         value float8, updated timestamp, the_geom geometry(LineString, 4326));
+INSERT INTO bench_line (name, category, value, updated, the_geom)
+  SELECT 'line ' || i, i % 16, random() * 1000, '2012-01-01'::timestamp + (i % 3650) * interval '1 day',
+         ST_SetSRID(ST_MakeLine(ARRAY(SELECT ST_MakePoint(x + j * 0.01, y + (random() - 0.5) * 0.02)
+                                        FROM generate_series(0, 7) AS j)), 4326)
+    FROM origin ORDER BY i;
+
+-- 17 vertices rings
+CREATE TABLE bench_polygon (gid serial PRIMARY KEY, name varchar(64), category int4,
+                            value float8, updated timestamp, the_geom geometry(Polygon, 4326));
+INSERT INTO bench_polygon (name, category, value, updated, the_geom)
+  SELECT 'polygon ' || i, i % 16, random() * 1000, '2012-01-01'::timestamp + (i % 3650) * interval '1 day',
+         ST_SetSRID(ST_Buffer(ST_MakePoint(x, y), 0.005 + random() * 0.02, 4), 4326)
+    FROM origin ORDER BY i;
+
+CREATE INDEX bench_point_the_geom_gist ON bench_point USING GIST (the_geom);
+CREATE INDEX bench_line_the_geom_gist ON bench_line USING GIST (the_geom);
+CREATE INDEX bench_polygon_the_geom_gist ON bench_polygon USING GIST (the_geom);
+
+ANALYZE;
+EOF
+
+
+echo "Write config: $CONFIG"
+cat > $CONFIG <<EOF
+<tinyows online_resource="http://127.0.0.1/cgi-bin/tinyows"
+	 schema_dir="`pwd`/schema/"
+	 estimated_extent="1">
+
+  <pg host="$PGHOST" user="$PGUSER" password="$PGPASSWORD" dbname="$DB" port="$PGPORT"/>
+
+  <metadata name="TinyOWS Server"
+	    title="TinyOWS Server - Benchmark Service ($ROWS rows)" />
+
+  <layer retrievable="1" writable="1" ns_prefix="tows" ns_uri="http://www.tinyows.org/"
+         name="world" title="World Administrative Boundaries" />
+
+  <layer retrievable="1" writable="1" ns_prefix="tows" ns_uri="http://www.tinyows.org/"
+         name="france" title="French Administrative Sub Boundaries (IGN - GeoFLA Departements)" />
+
+  <layer retrievable="1" writable="1" ns_prefix="tows" ns_uri="http://www.tinyows.org/"
+         name="bench_point" title="Benchmark Points" />
+
+  <layer retrievable="1" writable="1" ns_prefix="tows" ns_uri="http://www.tinyows.org/"
+         name="bench_line" title="Benchmark Lines" />
+
+  <layer retrievable="1" writable="1" ns_prefix="tows" ns_uri="http://www.tinyows.org/"
+         name="bench_polygon" title="Benchmark Polygons" />
+
+</tinyows>
+EOF
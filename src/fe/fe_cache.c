@@ -0,0 +1,363 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+/*
+ * Filter to SQL cache
+ *
+ * Map clients send the same few Filters again and again, only BBOX
+ * coordinates changing. Compiled SQL is kept in a bounded LRU cache, keyed
+ * by layer, version, srs and filter shape. Box and Envelope coordinates are
+ * not part of the shape: the SQL template holds a slot instead of each of
+ * these envelopes, and on a hit only envelopes are computed to fill them.
+ * Cache outlives the requests, so its memory comes from the heap.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../ows/ows.h"
+
+
+/*
+ * Initialize a filter cache structure
+ */
+fe_cache *fe_cache_init(size_t size)
+{
+  fe_cache *c;
+
+  c = malloc(sizeof(fe_cache));
+  assert(c);
+
+  c->index = hash_init(false);
+  c->first = NULL;
+  c->last = NULL;
+  c->count = 0;
+  c->size = size;
+  c->hits = 0;
+  c->misses = 0;
+
+  return c;
+}
+
+
+/*
+ * Release a cache entry
+ */
+static void fe_cache_entry_free(fe_cache_entry * e)
+{
+  assert(e);
+
+  buffer_free(e->key);
+  buffer_free(e->sql);
+  free(e);
+}
+
+
+/*
+ * Release filter cache structure
+ */
+void fe_cache_free(fe_cache * c)
+{
+  fe_cache_entry *e, *next;
+
+  assert(c);
+
+  for (e = c->first ; e ; e = next) {
+    next = e->next;
+    fe_cache_entry_free(e);
+  }
+
+  hash_free(c->index);
+  free(c);
+  c = NULL;
+}
+
+
+/*
+ * Unlink an entry from the LRU chain
+ */
+static void fe_cache_unlink(fe_cache * c, fe_cache_entry * e)
+{
+  if (e->prev) e->prev->next = e->next;
+  else         c->first = e->next;
+  if (e->next) e->next->prev = e->prev;
+  else         c->last = e->prev;
+}
+
+
+/*
+ * Link an entry as the most recently used one
+ */
+static void fe_cache_link(fe_cache * c, fe_cache_entry * e)
+{
+  e->prev = NULL;
+  e->next = c->first;
+  if (c->first) c->first->prev = e;
+  else          c->last = e;
+  c->first = e;
+}
+
+
+/*
+ * Add a string to a key, prefixed with its length
+ * So that no two different shapes could give the same key
+ */
+static void fe_cache_key_str(buffer * key, const char *str)
+{
+  if (!str) {
+    buffer_add(key, '-');
+    return;
+  }
+
+  buffer_add_int(key, (int) strlen(str));
+  buffer_add(key, ':');
+  buffer_add_str(key, str);
+}
+
+
+/*
+ * Box and Envelope handled by fe_envelope(): inside BBOX or a
+ * spatial function (but DWithin and Beyond, using a plain geometry)
+ */
+static bool fe_cache_is_slot(xmlNodePtr n)
+{
+  xmlNodePtr p;
+
+  p = n->parent;
+  if (!p || p->type != XML_ELEMENT_NODE) return false;
+  if (strcmp((char *) n->name, "Box") && strcmp((char *) n->name, "Envelope")) return false;
+
+  return fe_is_spatial_op((char *) p->name)
+         && strcmp((char *) p->name, "DWithin")
+         && strcmp((char *) p->name, "Beyond");
+}
+
+
+/*
+ * Add nodes shape to the key, and compute envelopes in document order
+ * Whole content is part of the key (namespace URI rather than prefix),
+ * but text inside envelopes
+ */
+static bool fe_cache_key_node(ows * o, buffer * typename, filter_encoding * fe,
+                              buffer * key, list * values, xmlNodePtr n, bool in_slot)
+{
+  xmlAttrPtr a;
+  xmlChar *content;
+  buffer *envelope;
+  bool slot;
+
+  for (/* empty */ ; n ; n = n->next) {
+    buffer_add(key, (char) ('a' + n->type));
+
+    if (n->type != XML_ELEMENT_NODE) {
+      if (in_slot) buffer_add(key, '?');
+      else {
+        content = xmlNodeGetContent(n);
+        fe_cache_key_str(key, (char *) content);
+        xmlFree(content);
+      }
+      continue;
+    }
+
+    fe_cache_key_str(key, n->ns ? (char *) n->ns->href : NULL);
+    fe_cache_key_str(key, (char *) n->name);
+
+    for (a = n->properties ; a ; a = a->next) {
+      fe_cache_key_str(key, a->ns ? (char *) a->ns->href : NULL);
+      fe_cache_key_str(key, (char *) a->name);
+      content = xmlNodeListGetString(n->doc, a->children, 1);
+      fe_cache_key_str(key, (char *) content);
+      xmlFree(content);
+    }
+
+    slot = !in_slot && fe_cache_is_slot(n);
+    if (slot) {
+      envelope = buffer_init();
+      envelope = fe_envelope(o, typename, fe, envelope, n);
+
+      if (fe->error_code != FE_NO_ERROR) {
+        buffer_free(envelope);
+        return false;
+      }
+      list_add(values, envelope);
+    }
+
+    buffer_add(key, '(');
+    if (!fe_cache_key_node(o, typename, fe, key, values, n->children, in_slot || slot))
+      return false;
+    buffer_add(key, ')');
+  }
+
+  return true;
+}
+
+
+/*
+ * Build the cache key of a Filter, and the envelopes to fill its slots
+ * Return false if an envelope is not valid: the filter is then let to
+ * the compiler, to report the error as usual
+ */
+bool fe_cache_key(ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr filter, buffer * key, list * values)
+{
+  wfs_request *wr;
+
+  assert(o && typename && fe && filter && key && values);
+
+  wr = o->request->request.wfs;
+
+  fe_cache_key_str(key, typename->buf);
+  buffer_add_int(key, ows_version_get(o->request->version));
+  buffer_add(key, ':');
+  if (wr->srs) buffer_add_int(key, wr->srs->srid);
+  else         buffer_add(key, '-');
+  buffer_add(key, ':');
+
+  return fe_cache_key_node(o, typename, fe, key, values, filter->children, false);
+}
+
+
+/*
+ * Return the SQL template cached under a key, or NULL if none
+ * Cache is created on first lookup, so misses are all counted
+ */
+buffer *fe_cache_get(ows * o, const buffer * key)
+{
+  fe_cache_entry *e;
+  fe_cache *c;
+  arena *prev;
+
+  assert(o && key);
+
+  if (!o->filter_cache_size) return NULL;
+
+  /* Cache outlives the request, so keep it out of the arena */
+  if (!o->filter_cache) {
+    prev = arena_use(NULL);
+    o->filter_cache = fe_cache_init(o->filter_cache_size);
+    arena_use(prev);
+  }
+  c = o->filter_cache;
+
+  e = hash_get(c->index, key->buf);
+  if (!e) {
+    c->misses++;
+    return NULL;
+  }
+
+  c->hits++;
+  fe_cache_unlink(c, e);
+  fe_cache_link(c, e);
+
+  return e->sql;
+}
+
+
+/*
+ * Cache a SQL template, evicting the least recently used one if full
+ * Template is kept only if the envelopes recorded by the compiler are
+ * the ones computed along the key, i.e if its slots are filled right
+ */
+void fe_cache_add(ows * o, buffer * key, buffer * sql, const list * slots, const list * values)
+{
+  list_node *ln, *lv;
+  fe_cache_entry *e;
+  fe_cache *c;
+  arena *prev;
+
+  assert(o && key && sql && slots && values);
+
+  if (!o->filter_cache_size) return;
+
+  for (ln = slots->first, lv = values->first ; ln && lv ; ln = ln->next, lv = lv->next)
+    if (ln->value->use != lv->value->use || memcmp(ln->value->buf, lv->value->buf, ln->value->use))
+      return;
+  if (ln || lv) return;
+
+  /* Cache outlives the request, so keep it out of the arena */
+  prev = arena_use(NULL);
+
+  if (!o->filter_cache) o->filter_cache = fe_cache_init(o->filter_cache_size);
+  c = o->filter_cache;
+
+  if (hash_get(c->index, key->buf)) {
+    arena_use(prev);
+    return;
+  }
+
+  if (c->count >= c->size) {
+    e = c->last;
+    fe_cache_unlink(c, e);
+    hash_remove(c->index, e->key);
+    fe_cache_entry_free(e);
+    c->count--;
+  }
+
+  e = malloc(sizeof(fe_cache_entry));
+  assert(e);
+  e->key = buffer_init();
+  buffer_copy(e->key, key);
+  e->sql = buffer_init();
+  buffer_copy(e->sql, sql);
+
+  hash_add(c->index, e->key, e);
+  fe_cache_link(c, e);
+  c->count++;
+
+  arena_use(prev);
+}
+
+
+/*
+ * Write a SQL template, each slot replaced by its envelope
+ */
+void fe_cache_render(buffer * sql, const buffer * template, const list * slots)
+{
+  list_node *ln;
+  size_t i, j;
+  int slot;
+
+  assert(sql && template && slots);
+
+  for (i = j = 0 ; i < template->use ; i++) {
+    if (template->buf[i] != FE_CACHE_SLOT) continue;
+
+    buffer_add_nstr(sql, template->buf + j, i - j);
+    for (slot = 0, i++ ; i < template->use && template->buf[i] != FE_CACHE_SLOT ; i++)
+      slot = slot * 10 + template->buf[i] - '0';
+    j = i + 1;
+
+    for (ln = slots->first ; ln && slot ; ln = ln->next, slot--);
+    if (ln) buffer_copy(sql, ln->value);
+  }
+
+  if (j < template->use) buffer_add_nstr(sql, template->buf + j, template->use - j);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -40,8 +40,8 @@ filter_encoding *filter_encoding_init()
   assert(fe);
 
   fe->sql = buffer_init();
+  fe->slots = NULL;
   fe->error_code = FE_NO_ERROR;
-  fe->in_not = false;
   fe->is_numeric = false;
 
   return fe;
@@ -56,6 +56,7 @@ void filter_encoding_free(filter_encoding * fe)
   assert(fe);
 
   buffer_free(fe->sql);
+  if (fe->slots) list_free(fe->slots);
   free(fe);
   fe = NULL;
 }
@@ -259,154 +260,274 @@ buffer *fe_property_name(ows * o, buffer * typename, filter_encoding * fe, buffe
 
 
 /*
- * Check if featureId or GmlObjectId are valid and return the appropriate string
+ * Add to a SQL request a match on a list of feature ids:
+ * id_name = 'id' or, if several, id_name = ANY('{"id1","id2"}')
+ * A single array literal is far cheaper to parse and plan than
+ * a long OR chain
  */
-buffer *fe_feature_id(ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n)
+void fe_featureid_sql(ows * o, buffer * sql, const buffer * id_name, const list * ids)
 {
-  char *escaped;
-  list *fe_list;
+  list_node *ln;
+  buffer *array;
+  char *escaped, *c;
+
+  assert(o && sql && id_name && ids);
+
+  if (!ids->first) {
+    buffer_add_str(sql, " FALSE");
+    return;
+  }
+
+  buffer_copy(sql, id_name);
+
+  if (ids->first == ids->last) {
+    buffer_add_str(sql, " = '");
+    escaped = ows_psql_escape_string(o, ids->first->value->buf);
+  } else {
+    array = buffer_init();
+    buffer_add(array, '{');
+
+    for (ln = ids->first ; ln ; ln = ln->next) {
+      buffer_add(array, '"');
+      for (c = ln->value->buf ; *c ; c++) {
+        if (*c == '"' || *c == '\\') buffer_add(array, '\\');
+        buffer_add(array, *c);
+      }
+      buffer_add(array, '"');
+      if (ln->next) buffer_add(array, ',');
+    }
+    buffer_add(array, '}');
+
+    buffer_add_str(sql, " = ANY('");
+    escaped = ows_psql_escape_string(o, array->buf);
+    buffer_free(array);
+  }
+
+  if (escaped) {
+    buffer_add_str(sql, escaped);
+    free(escaped);
+  }
+
+  if (ids->first == ids->last) buffer_add_str(sql, "'");
+  else                         buffer_add_str(sql, "')");
+}
+
+
+/*
+ * Check if featureId or GmlObjectId are valid and return the list of ids
+ * matching the typename queried (without layer prefix)
+ * Return NULL and set fe error code on error
+ */
+list *fe_feature_id_list(ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n)
+{
+  list *fe_list, *ids;
   bool feature_id, gid;
   xmlChar *fid = NULL;
   buffer *buf_fid, *id_name = NULL;
 
   assert(o && typename && n && fe);
 
-  for (feature_id = gid = false ; n ; n = n->next) {
-    if (n->type == XML_ELEMENT_NODE) {
-      buf_fid = buffer_init();
-
-      /* retrieve the property fid */
-      if (!strcmp((char *) n->name, "FeatureId")) {
-        feature_id = true;
-
-        /* only one type of identifier element must be included */
-        if (!gid) fid = xmlGetProp(n, (xmlChar *) "fid");
-        else {
-          fe->error_code = FE_ERROR_FID;
-          buffer_free(buf_fid);
-          return fe->sql;
-        }
-      }
+  ids = list_init();
+  list_index(ids);
 
-      /* retrieve the property gml:id */
-      if (!strcmp((char *) n->name, "GmlObjectId")) {
-        gid = true;
-
-        /* only one type of identifier element must be included */
-        if (feature_id == false) fid = xmlGetProp(n, (xmlChar *) "id");
-        else {
-          fe->error_code = FE_ERROR_FID;
-          buffer_free(buf_fid);
-          return fe->sql;
-        }
-      }
-      buffer_add_str(buf_fid, (char *) fid);
-      fe_list = list_explode('.', buf_fid);
-      xmlFree(fid);
-
-      /* Check if the layer_name match the typename queried */
-      if (fe_list->first && !buffer_cmp(fe_list->first->value, 
-          (ows_layer_no_uri(o->layers, 
-           ows_layer_prefix_to_uri(o->layers, typename)))->buf)) {
-        buffer_add_str(fe->sql, " FALSE"); /* We still execute the query */
-        list_free(fe_list);
-        buffer_free(buf_fid);
-        continue;
-      }
-
-      /* If there is no id column, raise an error */
-      id_name = ows_psql_id_column(o, ows_layer_prefix_to_uri(o->layers, typename));
-      if (!id_name || !id_name->use) {
-        fe->error_code = FE_ERROR_FEATUREID;
-        list_free(fe_list);
-        buffer_free(buf_fid);
-        return fe->sql;
+  for (feature_id = gid = false ; n ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE) continue;
+
+    /* retrieve the property fid */
+    if (!strcmp((char *) n->name, "FeatureId")) {
+      feature_id = true;
+
+      /* only one type of identifier element must be included */
+      if (!gid) fid = xmlGetProp(n, (xmlChar *) "fid");
+      else {
+        fe->error_code = FE_ERROR_FID;
+        list_free(ids);
+        return NULL;
       }
+    }
 
-      buffer_copy(fe->sql, id_name);
-      buffer_add_str(fe->sql, " = \'");
-      if (fe_list->last) escaped = ows_psql_escape_string(o, fe_list->last->value->buf);
-      else               escaped = ows_psql_escape_string(o, buf_fid->buf);
+    /* retrieve the property gml:id */
+    else if (!strcmp((char *) n->name, "GmlObjectId")) {
+      gid = true;
 
-      if (escaped) {
-        buffer_add_str(fe->sql, escaped);
-        free(escaped);
+      /* only one type of identifier element must be included */
+      if (feature_id == false) fid = xmlGetProp(n, (xmlChar *) "id");
+      else {
+        fe->error_code = FE_ERROR_FID;
+        list_free(ids);
+        return NULL;
       }
+    } else continue;
+
+    buf_fid = buffer_init();
+    if (fid) buffer_add_str(buf_fid, (char *) fid);
+    fe_list = list_explode('.', buf_fid);
+    xmlFree(fid);
+    fid = NULL;
+
+    /* Check if the layer_name match the typename queried */
+    if (fe_list->first && !buffer_cmp(fe_list->first->value, 
+        (ows_layer_no_uri(o->layers, 
+         ows_layer_prefix_to_uri(o->layers, typename)))->buf)) {
+      list_free(fe_list);
+      buffer_free(buf_fid);
+      continue;   /* We still execute the query */
+    }
 
-      buffer_add_str(fe->sql, "\'");
+    /* If there is no id column, raise an error */
+    if (!id_name) id_name = ows_psql_id_column(o, ows_layer_prefix_to_uri(o->layers, typename));
+    if (!id_name || !id_name->use) {
+      fe->error_code = FE_ERROR_FEATUREID;
       list_free(fe_list);
       buffer_free(buf_fid);
+      list_free(ids);
+      return NULL;
     }
 
-    if (n->next && n->next->type == XML_ELEMENT_NODE) buffer_add_str(fe->sql, " OR ");
+    /* Same id given twice is matched once */
+    if (fe_list->last && !in_list(ids, fe_list->last->value)) list_add_by_copy(ids, fe_list->last->value);
+    else if (!fe_list->last && !in_list(ids, buf_fid))        list_add_by_copy(ids, buf_fid);
+
+    list_free(fe_list);
+    buffer_free(buf_fid);
   }
 
+  return ids;
+}
+
+
+/*
+ * Check if featureId or GmlObjectId are valid and return the appropriate string
+ */
+buffer *fe_feature_id(ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n)
+{
+  list *ids;
+
+  assert(o && typename && n && fe);
+
+  ids = fe_feature_id_list(o, typename, fe, n);
+  if (!ids) return fe->sql;
+
+  /* All ids of the layer are matched in a single statement */
+  if (ids->first)
+    fe_featureid_sql(o, fe->sql, ows_psql_id_column(o, ows_layer_prefix_to_uri(o->layers, typename)), ids);
+  else buffer_add_str(fe->sql, " FALSE");
+
+  list_free(ids);
+
   return fe->sql;
 }
 
 
+
+/*
+ * Write the SQL matching the first operator of a Filter
+ */
+static filter_encoding *fe_filter_compile(ows * o, filter_encoding * fe, buffer * typename, xmlNodePtr n)
+{
+  if (fe_is_comparison_op((char *) n->name))  fe->sql = fe_comparison_op(o, typename, fe, n);
+  if (fe_is_spatial_op((char *) n->name))     fe->sql = fe_spatial_op(o, typename, fe, n);
+  if (fe_is_logical_op((char *) n->name))     fe->sql = fe_logical_op(o, typename, fe, n);
+  if (!strcmp((char *) n->name, "FeatureId")) fe->sql = fe_feature_id(o, typename, fe, n);
+  else if (!strcmp((char *) n->name, "GmlObjectId") && ows_version_get(o->request->version) == 110)
+    fe->sql = fe_feature_id(o, typename, fe, n); /* FIXME Is FeatureId should really have priority ? */
+
+  return fe;
+}
+
+
 /*
- * Translate an XML filter to a filter encoding structure with a buffer
+ * Translate a Filter element to a filter encoding structure with a buffer
  * containing a where condition of a SQL request usable into PostGis
  * and an error code if an error occured
+ * Filter comes from an already parsed (and validated) request document
+ * Already seen filter shapes are taken from the filter cache
  */
-filter_encoding *fe_filter(ows * o, filter_encoding * fe, buffer * typename, buffer * xmlchar)
+filter_encoding *fe_filter_node(ows * o, filter_encoding * fe, buffer * typename, xmlNodePtr filter)
 {
-  buffer * schema_path;
-  xmlDocPtr xmldoc;
+  buffer *key, *template;
+  list *values;
   xmlNodePtr n;
-  int ret = -1;
-
-  assert(o && fe && typename && xmlchar);
+  double start;
 
-  /* No validation if Filter came from KVP method
-     FIXME: really, but why ?                     */
-  if (o->check_schema && o->request->method == OWS_METHOD_XML) {
-    schema_path = buffer_init();
-    buffer_copy(schema_path, o->schema_dir);
-
-    if (ows_version_get(o->request->version) == 100) {
-      buffer_add_str(schema_path, WFS_SCHEMA_100);
-      ret = ows_schema_validation(o, schema_path, xmlchar, true, WFS_SCHEMA_TYPE_100);
-    } else {
-      buffer_add_str(schema_path, WFS_SCHEMA_110);
-      ret = ows_schema_validation(o, schema_path, xmlchar, true, WFS_SCHEMA_TYPE_110);
-    }
+  assert(o && fe && typename && filter);
 
-    if (ret != 0) {
-      buffer_free(schema_path);
-      fe->error_code = FE_ERROR_FILTER;
-      return fe;
-    }
-
-    buffer_free(schema_path);
+  if (!ows_libxml_check_namespace_element(o, filter)) {
+    fe->error_code = FE_ERROR_NAMESPACE;
+    return fe;
   }
 
-  xmldoc = xmlParseMemory(xmlchar->buf, xmlchar->use);
+  /* jump to the next element if there are spaces */
+  for (n = filter->children ; n && n->type != XML_ELEMENT_NODE ; n = n->next);
 
-  if (!xmldoc) {
+  if (!n) {
     fe->error_code = FE_ERROR_FILTER;
-    xmlFreeDoc(xmldoc);
     return fe;
   }
 
-  if (!ows_libxml_check_namespace(o, xmldoc->children)) {
-    fe->error_code = FE_ERROR_NAMESPACE;
-    xmlFreeDoc(xmldoc);
+  start = ows_time();
+  fe_optimize(filter);
+  for (n = filter->children ; n && n->type != XML_ELEMENT_NODE ; n = n->next);
+
+  if (!o->filter_cache_size || fe->sql->use) {
+    fe = fe_filter_compile(o, fe, typename, n);
+    ows_timing_add(o, OWS_TIMING_FILTER, start);
     return fe;
   }
 
-  n = xmldoc->children->children;
+  key = buffer_init();
+  values = list_init();
 
-  /* jump to the next element if there are spaces */
-  while (n->type != XML_ELEMENT_NODE) n = n->next;
+  if (!fe_cache_key(o, typename, fe, filter, key, values)) {
+    fe->error_code = FE_NO_ERROR;
+    fe = fe_filter_compile(o, fe, typename, n);
+  } else if ((template = fe_cache_get(o, key))) {
+    fe_cache_render(fe->sql, template, values);
+  } else {
+    fe->slots = list_init();
+    fe = fe_filter_compile(o, fe, typename, n);
 
-  if (fe_is_comparison_op((char *) n->name))  fe->sql = fe_comparison_op(o, typename, fe, n);
-  if (fe_is_spatial_op((char *) n->name))     fe->sql = fe_spatial_op(o, typename, fe, n);
-  if (fe_is_logical_op((char *) n->name))     fe->sql = fe_logical_op(o, typename, fe, n);
-  if (!strcmp((char *) n->name, "FeatureId")) fe->sql = fe_feature_id(o, typename, fe, n);
-  else if (!strcmp((char *) n->name, "GmlObjectId") && ows_version_get(o->request->version) == 110)
-    fe->sql = fe_feature_id(o, typename, fe, n); /* FIXME Is FeatureId should really have priority ? */
+    template = fe->sql;
+    fe->sql = buffer_init();
+    fe_cache_render(fe->sql, template, fe->slots);
+
+    if (fe->error_code == FE_NO_ERROR)
+      fe_cache_add(o, key, template, fe->slots, values);
+
+    buffer_free(template);
+    list_free(fe->slots);
+    fe->slots = NULL;
+  }
+
+  buffer_free(key);
+  list_free(values);
+  ows_timing_add(o, OWS_TIMING_FILTER, start);
+
+  return fe;
+}
+
+
+/*
+ * Translate an XML filter string to a filter encoding structure
+ * Used by KVP method, where Filter is not validated
+ * FIXME: really, but why ?
+ */
+filter_encoding *fe_filter(ows * o, filter_encoding * fe, buffer * typename, buffer * xmlchar)
+{
+  xmlDocPtr xmldoc;
+  xmlNodePtr n;
+
+  assert(o && fe && typename && xmlchar);
+
+  xmldoc = xmlParseMemory(xmlchar->buf, xmlchar->use);
+
+  if (!xmldoc || !(n = xmlDocGetRootElement(xmldoc))) {
+    fe->error_code = FE_ERROR_FILTER;
+    xmlFreeDoc(xmldoc);
+    return fe;
+  }
+
+  fe = fe_filter_node(o, fe, typename, n);
 
   xmlFreeDoc(xmldoc);
 
@@ -494,8 +615,7 @@ buffer *fe_kvp_bbox(ows * o, wfs_request * wr, buffer * layer_name, ows_bbox * b
 buffer *fe_kvp_featureid(ows * o, wfs_request * wr, buffer * layer_name, list * fid)
 {
   buffer *id_name, *where;
-  char *escaped;
-  list *fe;
+  list *fe, *ids;
   list_node *ln;
 
   assert(o && wr && layer_name && fid);
@@ -505,22 +625,17 @@ buffer *fe_kvp_featureid(ows * o, wfs_request * wr, buffer * layer_name, list *
   id_name = ows_psql_id_column(o, layer_name);
   if (!id_name || id_name->use == 0) return where;
 
-  buffer_add_str(where, " WHERE ");
-
+  ids = list_init();
   for (ln = fid->first ; ln ; ln = ln->next) {
     fe = list_explode('.', ln->value);
-    buffer_copy(where, id_name);
-    buffer_add_str(where, " = '");
-    escaped = ows_psql_escape_string(o, fe->last->value->buf);
-    if (escaped) {
-      buffer_add_str(where, escaped);
-      free(escaped);
-    }
-    buffer_add_str(where, "'");
+    list_add_by_copy(ids, fe->last->value);
     list_free(fe);
-
-    if (ln->next) buffer_add_str(where, " OR ");
   }
 
+  buffer_add_str(where, " WHERE ");
+  fe_featureid_sql(o, where, id_name, ids);
+  list_free(ids);
+
   return where;
 }
+
@@ -69,14 +69,8 @@ static buffer *fe_binary_logical_op(ows * o, buffer * typename, filter_encoding
   for ( node = node->next ; node ; node = node->next ) {
     if (node->type != XML_ELEMENT_NODE) continue;
 
-    /* Revert boolean logical if inside a Not */
-    if (!fe->in_not) {
-      if (!strcmp((char *) n->name, "And")) buffer_add_str(fe->sql, " AND ");
-      else if (!strcmp((char *) n->name, "Or")) buffer_add_str(fe->sql, " OR ");
-    } else {
-      if (!strcmp((char *) n->name, "And")) buffer_add_str(fe->sql, " OR ");
-      else if (!strcmp((char *) n->name, "Or")) buffer_add_str(fe->sql, " AND ");
-    }
+    if (!strcmp((char *) n->name, "And"))     buffer_add_str(fe->sql, " AND ");
+    else if (!strcmp((char *) n->name, "Or")) buffer_add_str(fe->sql, " OR ");
 
     /* Execute the matching function's type */
     if (fe_is_logical_op((char *) node->name))    fe->sql = fe_logical_op(o, typename, fe, node);
@@ -101,7 +95,6 @@ static buffer *fe_unary_logical_op(ows * o, buffer * typename, filter_encoding *
   assert(n);
 
   buffer_add_str(fe->sql, "not(");
-  fe->in_not++;
 
   n = n->children;
   while (n->type != XML_ELEMENT_NODE) n = n->next;
@@ -112,7 +105,6 @@ static buffer *fe_unary_logical_op(ows * o, buffer * typename, filter_encoding *
   else if (fe_is_comparison_op((char *) n->name)) fe->sql = fe_comparison_op(o, typename, fe, n);
 
   buffer_add_str(fe->sql, ")");
-  fe->in_not--;
 
   return fe->sql;
 }
@@ -0,0 +1,348 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+/*
+ * Filter rewriting, before SQL is written
+ *
+ * Logical operators of a Filter are simplified in place:
+ *   - nested And (or Or) are merged into their parent
+ *   - Not(Not(x)) is replaced by x, And or Or with a single operand by it
+ *   - among BBOX operands on the same property, one containing another
+ *     is dropped inside And, the contained one inside Or
+ *   - operands are ordered, index friendly and cheap predicates first
+ * Each rewrite keeps the filter meaning, so SQL written from the new tree
+ * returns the same features.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../ows/ows.h"
+
+
+/*
+ * Relative cost of an operand, lower first
+ * BBOX could use the spatial index, plain comparisons are cheap,
+ * exact spatial predicates are the most expensive ones
+ */
+static int fe_optimize_cost(xmlNodePtr n)
+{
+  char *name;
+
+  name = (char *) n->name;
+
+  if (!strcmp(name, "BBOX"))                                  return 0;
+  if (!strcmp(name, "PropertyIsLike"))                        return 2;
+  if (fe_is_comparison_op(name))                              return 1;
+  if (fe_is_logical_op(name))                                 return 3;
+  if (!strcmp(name, "DWithin") || !strcmp(name, "Beyond"))    return 5;
+  if (fe_is_spatial_op(name))                                 return 4;
+
+  return 6;
+}
+
+
+/*
+ * Remove a node, once its namespace declarations are moved to the parent
+ * (nodes kept from its subtree could refer to them)
+ */
+static void fe_optimize_remove(xmlNodePtr parent, xmlNodePtr n)
+{
+  xmlNsPtr ns;
+
+  if (n->nsDef) {
+    if (!parent->nsDef) parent->nsDef = n->nsDef;
+    else {
+      for (ns = parent->nsDef ; ns->next ; ns = ns->next);
+      ns->next = n->nsDef;
+    }
+    n->nsDef = NULL;
+  }
+
+  xmlUnlinkNode(n);
+  xmlFreeNode(n);
+}
+
+
+/*
+ * First element child of a node, or NULL
+ */
+static xmlNodePtr fe_optimize_child(xmlNodePtr n)
+{
+  for (n = n->children ; n && n->type != XML_ELEMENT_NODE ; n = n->next);
+
+  return n;
+}
+
+
+/*
+ * Read count numbers, separated by spaces or commas
+ */
+static bool fe_optimize_coords(const char *str, double *c, int count)
+{
+  char *end;
+  int i;
+
+  for (i = 0 ; i < count ; i++) {
+    while (*str == ' ' || *str == ',' || *str == '\t' || *str == '\n') str++;
+    c[i] = strtod(str, &end);
+    if (end == str) return false;
+    str = end;
+  }
+
+  while (*str == ' ' || *str == '\t' || *str == '\n') str++;
+
+  return *str == '\0';
+}
+
+
+/*
+ * Retrieve the property and envelope of a BBOX, as xmin, ymin, xmax, ymax
+ * Return false if envelope is not one we could compare
+ */
+static bool fe_optimize_bbox(xmlNodePtr n, xmlChar ** property, xmlNodePtr * envelope, double *box)
+{
+  xmlNodePtr p, lower, upper;
+  xmlChar *content;
+  bool ret;
+
+  *property = NULL;
+  p = fe_optimize_child(n);
+  if (!p) return false;
+
+  if (!strcmp((char *) p->name, "PropertyName")) {
+    *property = xmlNodeGetContent(p);
+    for (p = p->next ; p && p->type != XML_ELEMENT_NODE ; p = p->next);
+    if (!p) return false;
+  }
+
+  if (strcmp((char *) p->name, "Box") && strcmp((char *) p->name, "Envelope")) return false;
+  *envelope = p;
+
+  lower = fe_optimize_child(p);
+  if (!lower) return false;
+
+  if (!strcmp((char *) lower->name, "coordinates")) {
+    content = xmlNodeGetContent(lower);
+    ret = content && fe_optimize_coords((char *) content, box, 4);
+    xmlFree(content);
+  } else if (!strcmp((char *) lower->name, "lowerCorner")) {
+    for (upper = lower->next ; upper && upper->type != XML_ELEMENT_NODE ; upper = upper->next);
+    if (!upper || strcmp((char *) upper->name, "upperCorner")) return false;
+
+    content = xmlNodeGetContent(lower);
+    ret = content && fe_optimize_coords((char *) content, box, 2);
+    xmlFree(content);
+    content = xmlNodeGetContent(upper);
+    ret = ret && content && fe_optimize_coords((char *) content, box + 2, 2);
+    xmlFree(content);
+  } else return false;
+
+  /* Invalid envelope is let to fe_envelope(), to report it */
+  return ret && box[0] < box[2] && box[1] < box[3];
+}
+
+
+/*
+ * Check if two BBOX are on the same property and in the same srs,
+ * and if so if first envelope contains the second one
+ */
+static bool fe_optimize_bbox_contains(xmlNodePtr a, xmlNodePtr b)
+{
+  xmlChar *prop_a, *prop_b, *srs_a, *srs_b;
+  xmlNodePtr env_a, env_b;
+  double box_a[4], box_b[4];
+  bool ret;
+
+  ret = fe_optimize_bbox(a, &prop_a, &env_a, box_a);
+  ret = fe_optimize_bbox(b, &prop_b, &env_b, box_b) && ret;
+
+  if (ret) {
+    ret = (!prop_a && !prop_b) || (prop_a && prop_b && xmlStrEqual(prop_a, prop_b));
+    xmlFree(prop_a);
+    xmlFree(prop_b);
+  } else {
+    xmlFree(prop_a);
+    xmlFree(prop_b);
+    return false;
+  }
+
+  if (!ret || !xmlStrEqual(env_a->name, env_b->name)) return false;
+
+  srs_a = xmlGetProp(env_a, (xmlChar *) "srsName");
+  srs_b = xmlGetProp(env_b, (xmlChar *) "srsName");
+  ret = (!srs_a && !srs_b) || (srs_a && srs_b && xmlStrEqual(srs_a, srs_b));
+  xmlFree(srs_a);
+  xmlFree(srs_b);
+
+  return ret
+         && box_a[0] <= box_b[0] && box_a[1] <= box_b[1]
+         && box_a[2] >= box_b[2] && box_a[3] >= box_b[3];
+}
+
+
+/*
+ * Drop BBOX operands made useless by another one:
+ * inside And the larger one, inside Or the smaller one
+ */
+static void fe_optimize_bbox_operands(xmlNodePtr n, bool and)
+{
+  xmlNodePtr a, b, next;
+
+  for (a = fe_optimize_child(n) ; a ; a = next) {
+    for (next = a->next ; next && next->type != XML_ELEMENT_NODE ; next = next->next);
+    if (strcmp((char *) a->name, "BBOX")) continue;
+
+    for (b = fe_optimize_child(n) ; b ; b = b->next) {
+      if (b == a || b->type != XML_ELEMENT_NODE || strcmp((char *) b->name, "BBOX")) continue;
+
+      if (and ? fe_optimize_bbox_contains(a, b) : fe_optimize_bbox_contains(b, a)) {
+        fe_optimize_remove(n, a);
+        break;
+      }
+    }
+  }
+}
+
+
+/*
+ * Order operands by cost, keeping the document order of equal ones
+ */
+static void fe_optimize_order(xmlNodePtr n)
+{
+  xmlNodePtr *operands, c;
+  size_t i, j, count;
+  bool sorted;
+
+  for (count = 0, c = fe_optimize_child(n) ; c ; c = c->next)
+    if (c->type == XML_ELEMENT_NODE) count++;
+  if (count < 2) return;
+
+  operands = malloc(count * sizeof(xmlNodePtr));
+  assert(operands);
+
+  for (i = 0, c = fe_optimize_child(n) ; c ; c = c->next)
+    if (c->type == XML_ELEMENT_NODE) operands[i++] = c;
+
+  for (sorted = true, i = 1 ; i < count ; i++) {
+    c = operands[i];
+    for (j = i ; j > 0 && fe_optimize_cost(operands[j - 1]) > fe_optimize_cost(c) ; j--)
+      operands[j] = operands[j - 1];
+    operands[j] = c;
+    if (j != i) sorted = false;
+  }
+
+  if (!sorted) {
+    for (i = 0 ; i < count ; i++) {
+      xmlUnlinkNode(operands[i]);
+      xmlAddChild(n, operands[i]);
+    }
+  }
+
+  free(operands);
+}
+
+
+/*
+ * Simplify a logical operator, once its operands are
+ * Return the node taking its place (itself most of the time)
+ */
+static xmlNodePtr fe_optimize_node(xmlNodePtr n)
+{
+  xmlNodePtr c, g, next;
+  bool and;
+
+  /* Operands first */
+  for (c = fe_optimize_child(n) ; c ; c = next) {
+    for (next = c->next ; next && next->type != XML_ELEMENT_NODE ; next = next->next);
+    if (fe_is_logical_op((char *) c->name)) fe_optimize_node(c);
+  }
+
+  c = fe_optimize_child(n);
+  if (!c) return n;
+
+  /* Not(Not(x)) is x */
+  if (!strcmp((char *) n->name, "Not")) {
+    if (strcmp((char *) c->name, "Not") || !(g = fe_optimize_child(c))) return n;
+
+    xmlUnlinkNode(g);
+    fe_optimize_remove(n, c);
+    xmlReplaceNode(n, g);
+    fe_optimize_remove(g->parent, n);
+
+    return g;
+  }
+
+  and = !strcmp((char *) n->name, "And");
+
+  /* Merge nested operators of the same kind */
+  for ( ; c ; c = next) {
+    for (next = c->next ; next && next->type != XML_ELEMENT_NODE ; next = next->next);
+    if (!xmlStrEqual(c->name, n->name)) continue;
+
+    for (g = fe_optimize_child(c) ; g ; g = fe_optimize_child(c))
+      xmlAddPrevSibling(c, g);
+    fe_optimize_remove(n, c);
+  }
+
+  fe_optimize_bbox_operands(n, and);
+
+  /* A single operand left takes the operator place */
+  c = fe_optimize_child(n);
+  if (!c) return n;
+  for (next = c->next ; next && next->type != XML_ELEMENT_NODE ; next = next->next);
+  if (!next) {
+    xmlUnlinkNode(c);
+    xmlReplaceNode(n, c);
+    fe_optimize_remove(c->parent, n);
+
+    return c;
+  }
+
+  fe_optimize_order(n);
+
+  return n;
+}
+
+
+/*
+ * Simplify a Filter element in place
+ */
+void fe_optimize(xmlNodePtr filter)
+{
+  xmlNodePtr n;
+
+  assert(filter);
+
+  n = fe_optimize_child(filter);
+  if (n && fe_is_logical_op((char *) n->name)) fe_optimize_node(n);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
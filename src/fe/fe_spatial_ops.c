@@ -80,7 +80,7 @@ static  buffer *fe_transform_coord_gml2_to_psql(buffer * coord)
  */
 buffer *fe_envelope(ows * o, buffer * typename, filter_encoding * fe, buffer *envelope, xmlNodePtr n)
 {
-  list *coord_min, *coord_max, *coord_pair;
+  list *coord_min, *coord_max, *coord_pair, *slots;
   xmlChar *content, *srsname;
   buffer *name, *tmp;
   ows_bbox *bbox;
@@ -94,6 +94,22 @@ buffer *fe_envelope(ows * o, buffer * typename, filter_encoding * fe, buffer *en
   assert(typename);
   assert(envelope);
 
+  /* Compiling a template for the cache: envelope is kept aside, a slot is written instead */
+  if (fe->slots) {
+    slots = fe->slots;
+    fe->slots = NULL;
+    tmp = buffer_init();
+    tmp = fe_envelope(o, typename, fe, tmp, n);
+    fe->slots = slots;
+
+    list_add(slots, tmp);
+    buffer_add(envelope, FE_CACHE_SLOT);
+    buffer_add_int(envelope, slots->size - 1);
+    buffer_add(envelope, FE_CACHE_SLOT);
+
+    return envelope;
+  }
+
   name = buffer_init();
   buffer_add_str(name, (char *) n->name);
 
@@ -407,66 +423,44 @@ static buffer *fe_distance_functions(ows * o, buffer * typename, filter_encoding
 }
 
 
+/*
+ * Envelope is brought to the layer srs, rather than the geometry column
+ * to the request one, so the spatial index could still be used
+ */
 static buffer *fe_bbox_layer(ows *o, buffer *typename, buffer *sql, buffer *propertyname, buffer *envelope)
 {
+  buffer *geom;
   int srid = -1;
-  bool transform = false;
 
   assert(propertyname);
   assert(envelope);
   assert(sql);
   assert(o);
 
-  buffer_add_str(sql, "(_ST_Intersects(");
+  if (o->request->request.wfs->srs)
+    srid = ows_srs_get_srid_from_layer(o, ows_layer_prefix_to_uri(o->layers, typename));
 
-  if (o->request->request.wfs->srs) {
-    srid = o->request->request.wfs->srs->srid;
-    transform = true;
+  geom = buffer_init();
+  if (srid != -1) buffer_add_str(geom, "ST_Transform(");
+  buffer_copy(geom, envelope);
+  if (srid != -1) {
+    buffer_add(geom, ',');
+    buffer_add_int(geom, srid);
+    buffer_add(geom, ')');
   }
 
-  if (transform) buffer_add_str(sql, "ST_Transform(");
-
-  buffer_add(sql, '"');
+  buffer_add_str(sql, "(_ST_Intersects(\"");
   buffer_copy(sql, propertyname);
-  buffer_add(sql, '"');
-
-  if (transform) {
-    buffer_add(sql, ',');
-    buffer_add_int(sql, srid);
-    buffer_add(sql, ')');
-  }
-
-  buffer_add_str(sql, ",");
-  if (transform) buffer_add_str(sql, "ST_Transform(");
-  buffer_copy(sql, envelope);
-  if (transform) {
-    buffer_add(sql, ',');
-    buffer_add_int(sql, srid);
-    buffer_add(sql, ')');
-  }
-  buffer_add_str(sql, ") AND ");
-  if (transform) buffer_add_str(sql, "ST_Transform(");
-
-  buffer_add(sql, '"');
+  buffer_add_str(sql, "\",");
+  buffer_copy(sql, geom);
+  buffer_add_str(sql, ") AND \"");
   buffer_copy(sql, propertyname);
-  buffer_add(sql, '"');
-
-  if (transform) {
-    buffer_add(sql, ',');
-    buffer_add_int(sql, srid);
-    buffer_add(sql, ')');
-  }
-
-  buffer_add_str(sql, " && ");
-  if (transform) buffer_add_str(sql, "ST_Transform(");
-  buffer_copy(sql, envelope);
-  if (transform) {
-    buffer_add(sql, ',');
-    buffer_add_int(sql, srid);
-    buffer_add(sql, ')');
-  }
+  buffer_add_str(sql, "\" && ");
+  buffer_copy(sql, geom);
   buffer_add_str(sql, ")");
 
+  buffer_free(geom);
+
   return sql;
 }
 
@@ -506,7 +500,7 @@ static buffer *fe_bbox(ows * o, buffer * typename, filter_encoding * fe, xmlNode
     /* retrieve the geometry matching the bbox */
     if (!strcmp((char *) n->name, "Box") || !strcmp((char *) n->name, "Envelope")) {
       envelope = buffer_init();
-      envelope = fe_envelope(o, layer_name, fe, envelope, n);
+      envelope = fe_envelope(o, typename, fe, envelope, n);
     } else {
       fe->error_code = FE_ERROR_FILTER;
     }
@@ -514,9 +508,8 @@ static buffer *fe_bbox(ows * o, buffer * typename, filter_encoding * fe, xmlNode
     buffer_add(fe->sql, '(');
     for (ln = columns->first ; ln ; ln = ln->next) {
       if (envelope) fe->sql = fe_bbox_layer(o, typename, fe->sql, ln->value, envelope);
-      if      (ln->next && (fe->in_not == 0 || !fe->in_not%2)) buffer_add_str(fe->sql, " OR ");
-      else if (ln->next && fe->in_not%2)                       buffer_add_str(fe->sql, " AND ");
-      else                                                     buffer_add_str(fe->sql, ")");
+      if (ln->next) buffer_add_str(fe->sql, " OR ");
+      else          buffer_add_str(fe->sql, ")");
     }
 
   } else {
@@ -530,7 +523,7 @@ static buffer *fe_bbox(ows * o, buffer * typename, filter_encoding * fe, xmlNode
         return fe->sql;
       }
       envelope = buffer_init();
-      envelope = fe_envelope(o, layer_name, fe, envelope, n);
+      envelope = fe_envelope(o, typename, fe, envelope, n);
     } else {
       fe->error_code = FE_ERROR_FILTER;
     }
@@ -1371,7 +1371,7 @@ static void metadata_value(char *yytext, bool quotes)
 			return;
 		case MAP_MD_TOWS_LOG_LEVEL:
 			i = atoi(yytext);
-			if (i > 0 && i < 16) map_o->log_level = i;
+			if (i > 0 && i < 32) map_o->log_level = i;
 			return;
                 case MAP_MD_TOWS_WFS_DEFAULT_VERSION:
 			ows_version_set_str(map_o->wfs_default_version, yytext);
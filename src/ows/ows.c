@@ -34,7 +34,7 @@
 /*
  * Connect the ows to the database specified in configuration file
  */
-static void ows_pg(ows * o, char *con_str)
+void ows_pg(ows * o, char *con_str)
 {
   assert(o);
   assert(con_str);
@@ -64,7 +64,7 @@ static void ows_pg(ows * o, char *con_str)
 /*
  * Initialize an ows struct
  */
-static ows *ows_init()
+ows *ows_init()
 {
   ows *o;
 
@@ -84,7 +84,7 @@ static ows *ows_init()
   o->online_resource = buffer_init();
   o->schema_dir = buffer_init();
   o->log_file = NULL;
-  o->log = NULL;
+  o->log = ows_logger_init();
   o->log_level=0;
   o->encoding = buffer_init();
   o->db_encoding = buffer_init();
@@ -98,11 +98,27 @@ static ows *ows_init()
   o->expose_pk = false;
   o->check_schema = true;
   o->check_valid_geom = true;
+  o->server_timing = false;
+  o->request_max_size = OWS_REQUEST_MAX_SIZE;
+  o->request_spool_size = OWS_REQUEST_SPOOL_SIZE;
+  o->query_mapped = 0;
+  o->filter_cache_size = OWS_FILTER_CACHE_SIZE;
   o->metadata = NULL;
   o->contact = NULL;
   o->postgis_version = NULL;
   o->schema_wfs_100 = NULL;
   o->schema_wfs_110 = NULL;
+  o->schema_time = 0.0;
+  o->arena = arena_init();
+  o->filter_cache = NULL;
+  o->metrics = ows_metrics_init();
+  o->metrics_token = NULL;
+  ows_timing_start(o);
+  o->gml_srsname = NULL;
+  o->gml_srs = NULL;
+#if TINYOWS_GEOS
+  o->geos = GEOS_init_r();
+#endif
   o->wfs_default_version = ows_version_init();
   ows_version_set(o->wfs_default_version, 1, 1, 0);
 
@@ -192,6 +208,11 @@ void ows_flush(ows * o, FILE * output)
   fprintf(output, "estimated_extent: %d\n", o->estimated_extent?1:0);
   fprintf(output, "check_schema: %d\n", o->check_schema?1:0);
   fprintf(output, "check_valid_geom: %d\n", o->check_valid_geom?1:0);
+  fprintf(output, "server_timing: %d\n", o->server_timing?1:0);
+  fprintf(output, "metrics: %d\n", o->metrics_token?1:0);
+  fprintf(output, "request_max_size: %lu\n", (unsigned long) o->request_max_size);
+  fprintf(output, "request_spool_size: %lu\n", (unsigned long) o->request_spool_size);
+  fprintf(output, "filter_cache_size: %lu\n", (unsigned long) o->filter_cache_size);
 
   fprintf(output, "schema WFS 1.0: %d\n", o->schema_wfs_100?1:0);
   fprintf(output, "schema WFS 1.1: %d\n", o->schema_wfs_110?1:0);
@@ -211,7 +232,7 @@ void ows_free(ows * o)
   if (o->online_resource)      buffer_free(o->online_resource);
   if (o->pg)                   PQfinish(o->pg);
   if (o->log_file)             buffer_free(o->log_file);
-  if (o->log)                  fclose(o->log);
+  if (o->log)                  ows_logger_free(o->log);
   if (o->pg_dsn)               buffer_free(o->pg_dsn);
   if (o->cgi)                  array_free(o->cgi);
   if (o->psql_requests)        list_free(o->psql_requests);
@@ -226,36 +247,21 @@ void ows_free(ows * o)
   if (o->postgis_version)      ows_version_free(o->postgis_version);
   if (o->schema_wfs_100)       xmlSchemaFree(o->schema_wfs_100);
   if (o->schema_wfs_110)       xmlSchemaFree(o->schema_wfs_110);
+  if (o->gml_srsname)          buffer_free(o->gml_srsname);
+  if (o->gml_srs)              ows_srs_free(o->gml_srs);
+  if (o->filter_cache)         fe_cache_free(o->filter_cache);
+  if (o->metrics)              ows_metrics_free(o->metrics);
+  if (o->metrics_token)        buffer_free(o->metrics_token);
+#if TINYOWS_GEOS
+  if (o->geos)                 GEOS_finish_r(o->geos);
+#endif
+  if (o->arena)                arena_free(o->arena);  /* Last one, as still used by previous ones */
 
   free(o);
   o = NULL;
 }
 
 
-void ows_log(ows *o, int log_level, const char *log)
-{
-  char *t, *p;
-  time_t ts;
-
-  if (o->log_file && !o->log) o->log = fopen(o->log_file->buf, "a");
-  if (!o->log || !(o->log_level & log_level)) return;
-
-  ts = time(NULL);
-  t = ctime(&ts);
-
-  /* Suppress ctime \n last char */
-  for (p = t; *p && *p != '\n'; p++);
-  *p = '\0';
-
-  if      (log_level & 1) fprintf(o->log, "[%s] [ERROR] %s\n", t, log);
-  else if (log_level & 2) fprintf(o->log, "[%s] [EVENT] %s\n", t, log);
-  else if (log_level & 4) fprintf(o->log, "[%s] [QUERY] %s\n", t, log);
-  else if (log_level & 8) fprintf(o->log, "[%s] [SQL] %s\n", t, log);
-
-  fflush(o->log);
-}
-
-
 void ows_usage(ows * o)
 {
   fprintf(stdout, "TinyOWS version:   %s\n", TINYOWS_VERSION);
@@ -266,6 +272,11 @@ void ows_usage(ows * o)
   fprintf(stdout, "FCGI support:      Yes\n");
 #else
   fprintf(stdout, "FCGI support:      No\n");
+#endif
+#if TINYOWS_GEOS
+  fprintf(stdout, "GEOS support:      Yes\n");
+#else
+  fprintf(stdout, "GEOS support:      No\n");
 #endif
   if (o->mapfile)
     fprintf(stdout, "Config File Path:  %s (Mapfile)\n", o->config_file->buf);
@@ -282,16 +293,33 @@ void ows_usage(ows * o)
   fprintf(stdout, "Schema dir:        %s\n", o->schema_dir->buf);
   if (o->log_file) {
     fprintf(stdout, "Log file:          %s\n", o->log_file->buf);
-    fprintf(stdout, "Log level:         %s%s%s%s\n",(o->log_level & 1)?"ERROR ":"",
+    fprintf(stdout, "Log level:         %s%s%s%s%s\n",(o->log_level & 1)?"ERROR ":"",
             (o->log_level & 2)?"EVENT ":"",
             (o->log_level & 4)?"QUERY ":"",
-            (o->log_level & 8)?"SQL":"" );
+            (o->log_level & 8)?"SQL ":"",
+            (o->log_level & 16)?"TIMING":"" );
+    fprintf(stdout, "Log format:        %s\n", o->log->json?"JSON lines":"Text");
+    fprintf(stdout, "Log sampling:      QUERY 1/%d SQL 1/%d TIMING 1/%d\n",
+            o->log->sampling[2], o->log->sampling[3], o->log->sampling[4]);
   }
 
   fprintf(stdout, "Display bbox:      %s\n", o->display_bbox?"Yes":"No");
   fprintf(stdout, "Estimated extent:  %s\n", o->estimated_extent?"Yes":"No");
   fprintf(stdout, "Check schema:      %s\n", o->check_schema?"Yes":"No");
+  if (o->check_schema) {
+    if (!o->schema_wfs_100 || !o->schema_wfs_110) ows_schema_compile(o);
+    fprintf(stdout, "Schema compile:    %.3f s%s\n", o->schema_time,
+            (o->schema_wfs_100 && o->schema_wfs_110) ? "" : " (failed)");
+  }
   fprintf(stdout, "Check valid geoms: %s\n", o->check_valid_geom?"Yes":"No");
+  fprintf(stdout, "Server-Timing:     %s\n", o->server_timing?"Yes":"No");
+  fprintf(stdout, "Metrics:           %s\n", o->metrics_token?"Yes":"No");
+  if (o->request_max_size)
+    fprintf(stdout, "Max request size:  %lu\n", (unsigned long) o->request_max_size);
+  if (o->request_spool_size)
+    fprintf(stdout, "Spool size:        %lu\n", (unsigned long) o->request_spool_size);
+  if (o->filter_cache_size)
+    fprintf(stdout, "Filter cache:      %lu\n", (unsigned long) o->filter_cache_size);
   if (o->max_features)
     fprintf(stdout, "Max features:      %d\n", o->max_features);
 
@@ -300,7 +328,7 @@ void ows_usage(ows * o)
 }
 
 
-static void ows_kvp_or_xml(ows *o, char *query)
+void ows_kvp_or_xml(ows *o, char *query)
 {
   /*
    * Request encoding and HTTP method WFS 1.1.0 -> 6.5
@@ -336,10 +364,14 @@ static void ows_kvp_or_xml(ows *o, char *query)
 }
 
 
+/* Benchmarks link everything but this entry point */
+#ifndef OWS_NO_MAIN
 int main(int argc, char *argv[])
 {
   ows *o;
   char *query;
+  double start;
+  bool metrics;
 
   o = ows_init();
   o->config_file = buffer_init();
@@ -368,6 +400,13 @@ int main(int argc, char *argv[])
   if (!o->exit) ows_layers_storage_fill(o);
   if (!o->exit) ows_log(o, 2, "== Filling Storage ==");
 
+  /* Compile XML schemas before the first request
+     (a CGI process serves a single one, so only with FCGI) */
+#if TINYOWS_FCGI
+  if (!o->exit && o->check_schema) ows_schema_compile(o);
+  if (!o->exit && o->check_schema) ows_log(o, 2, "== Schemas Compilation ==");
+#endif
+
   o->init = false;
 
 #if TINYOWS_FCGI
@@ -375,8 +414,16 @@ int main(int argc, char *argv[])
   while (FCGI_Accept() >= 0) {
 #endif
 
+    /* Everything allocated from now on only lives during this request */
+    arena_use(o->arena);
+    ows_timing_start(o);
+    ows_log_request(o);
+
     query=NULL;
+    metrics = false;
+    start = ows_time();
     if (!o->exit) query = cgi_getback_query(o);  /* Retrieve safely query string */
+    ows_timing_add(o, OWS_TIMING_PARSE, start);
     if (!o->exit) ows_log(o, 4, query);          /* Log input query if asked */
 
     if (!o->exit && (!query || !strlen(query))) {
@@ -400,6 +447,7 @@ int main(int argc, char *argv[])
     if (!o->exit) o->request = ows_request_init();
     if (!o->exit) ows_kvp_or_xml(o, query);  /* Method is KVP or XML ? */
 
+    start = ows_time();
     if (!o->exit) {
 
       switch (o->request->method) {
@@ -407,6 +455,7 @@ int main(int argc, char *argv[])
           o->cgi = cgi_parse_kvp(o, query);
           break;
         case OWS_METHOD_XML:
+          o->request->body = query;
           o->cgi = cgi_parse_xml(o, query);
           break;
 
@@ -414,6 +463,14 @@ int main(int argc, char *argv[])
           ows_error(o, OWS_ERROR_REQUEST_HTTP, "Wrong HTTP request Method", "http");
       }
     }
+    ows_timing_add(o, OWS_TIMING_PARSE, start);
+
+    /* Admin request, not a service one */
+    if (!o->exit && ows_metrics_is_request(o, o->cgi)) {
+      ows_metrics_report(o);
+      metrics = true;
+      o->exit = true;
+    }
 
     if (!o->exit) o->psql_requests = list_init();
     if (!o->exit) ows_metadata_fill(o, o->cgi);                    /* Fill service's metadata */
@@ -432,16 +489,49 @@ int main(int argc, char *argv[])
       }
     }
 
+    if (o->request && !metrics) ows_metrics_select(o);
+
     if (o->request) {
       ows_request_free(o->request);
       o->request=NULL;
     }
 
+    if (o->cgi) {
+      array_free(o->cgi);
+      o->cgi = NULL;
+    }
+
+    if (o->psql_requests) {
+      list_free(o->psql_requests);
+      o->psql_requests = NULL;
+    }
+
+    if (o->metadata && o->metadata->type) {
+      buffer_free(o->metadata->type);
+      o->metadata->type = NULL;
+    }
+
+    if (o->metadata && o->metadata->versions) {
+      list_free(o->metadata->versions);
+      o->metadata->versions = NULL;
+    }
+
     /* We allocated memory only on post case */
-    if (cgi_method_post() && query) free(query);
+    if (cgi_method_post() && query) cgi_body_free(o, query);
+
+    /* Release in one go all memory still used by this request */
+    arena_use(NULL);
+    arena_reset(o->arena);
+
+    /* Waiting for a slow client is part of the request too */
+    start = ows_time();
+    fflush(o->output);
+    ows_timing_add(o, OWS_TIMING_WRITE, start);
+    ows_timing_log(o);
+    ows_metrics_record(o);
+    ows_log_flush(o);  /* Response is sent, now write log lines */
 
 #if TINYOWS_FCGI
-    fflush(stdout);
     o->exit = false;
   }
   ows_log(o, 2, "== FCGI SHUTDOWN ==");
@@ -454,3 +544,4 @@ int main(int argc, char *argv[])
 
   return EXIT_SUCCESS;
 }
+#endif
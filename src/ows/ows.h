@@ -35,6 +35,10 @@
 #include "fcgios.h"
 #endif
 
+#if TINYOWS_GEOS
+#include <geos_c.h>
+#endif
+
 #include "../ows_struct.h"
 #include "../ows_api.h"
 
@@ -21,6 +21,7 @@
 */
 
 
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -62,7 +63,20 @@ static void ows_parse_config_tinyows(ows * o, xmlTextReaderPtr r)
   a = xmlTextReaderGetAttribute(r, (xmlChar *) "log_level");
   if (a) {
     log_level = atoi((char *) a);
-    if (log_level > 0 && log_level < 16) o->log_level = log_level;
+    if (log_level > 0 && log_level < 32) o->log_level = log_level;
+    xmlFree(a);
+  }
+
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "log_format");
+  if (a) {
+    o->log->json = !strcmp((char *) a, "json");
+    o->log->second = -1;  /* stamp format changed */
+    xmlFree(a);
+  }
+
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "log_sampling");
+  if (a) {
+    ows_log_sampling(o, (char *) a);
     xmlFree(a);
   }
 
@@ -104,6 +118,39 @@ static void ows_parse_config_tinyows(ows * o, xmlTextReaderPtr r)
     xmlFree(a);
   }
 
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "server_timing");
+  if (a) {
+    if (atoi((char *) a)) o->server_timing = true;
+    xmlFree(a);
+  }
+
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "metrics_token");
+  if (a) {
+    if (*a) {
+      o->metrics_token = buffer_init();
+      buffer_add_str(o->metrics_token, (char *) a);
+    }
+    xmlFree(a);
+  }
+
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "request_max_size");
+  if (a) {
+    o->request_max_size = strtoul((char *) a, NULL, 10);
+    xmlFree(a);
+  }
+
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "request_spool_size");
+  if (a) {
+    o->request_spool_size = strtoul((char *) a, NULL, 10);
+    xmlFree(a);
+  }
+
+  a = xmlTextReaderGetAttribute(r, (xmlChar *) "filter_cache_size");
+  if (a) {
+    o->filter_cache_size = strtoul((char *) a, NULL, 10);
+    xmlFree(a);
+  }
+
   a = xmlTextReaderGetAttribute(r, (xmlChar *) "encoding");
   if (a) {
     buffer_add_str(o->encoding, (char *) a);
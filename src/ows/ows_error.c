@@ -30,7 +30,7 @@
 /*
  * Transform an error code into an error message
  */
-static char *ows_error_code_string(enum ows_error_code code)
+char *ows_error_code_string(enum ows_error_code code)
 {
   switch (code) {
     case OWS_ERROR_OPERATION_NOT_SUPPORTED:
@@ -59,6 +59,8 @@ static char *ows_error_code_string(enum ows_error_code code)
       return "MissingMetadata";
     case OWS_ERROR_NO_SRS_DEFINED:
       return "NoSrsDefined";
+    case OWS_ERROR_REQUEST_TOO_LARGE:
+      return "RequestTooLarge";
   }
 
   assert(0); /* Should not happen */
@@ -76,12 +78,16 @@ void ows_error(ows * o, enum ows_error_code code, char *message, char *locator)
 
   assert(!o->exit);
   o->exit = true;
+  o->metrics->ows_errors[code]++;
 
   ows_log(o, 1, message);
 
 #if TINYOWS_FCGI
   if ((o->init && FCGI_Accept() >= 0) || !o->init) {
 #endif
+    ows_timing_header(o);
+    if (code == OWS_ERROR_REQUEST_TOO_LARGE)
+      fprintf(o->output, "Status: 413 Request Entity Too Large\n");
     fprintf(o->output, "Content-Type: application/xml\n\n");
     fprintf(o->output, "<?xml version='1.0' encoding='UTF-8'?>\n");
     fprintf(o->output, "<ows:ExceptionReport\n");
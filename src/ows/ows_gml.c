@@ -0,0 +1,756 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * GML Simple Features to PostGIS EWKB decoder
+ *
+ * Handle GML 2 and GML 3 simple geometries directly from the libxml2 tree,
+ * so the common Insert/Update/Filter cases don't need a ST_GeomFromGML
+ * round trip. Anything outside of this subset (curves, surfaces, xlink,
+ * reprojection...) is reported as unsupported, and caller must then fall
+ * back on PostGIS parser.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ows.h"
+
+
+#define OWS_GML_WKB_POINT               1
+#define OWS_GML_WKB_LINESTRING          2
+#define OWS_GML_WKB_POLYGON             3
+#define OWS_GML_WKB_MULTIPOINT          4
+#define OWS_GML_WKB_MULTILINESTRING     5
+#define OWS_GML_WKB_MULTIPOLYGON        6
+#define OWS_GML_WKB_GEOMETRYCOLLECTION  7
+
+#define OWS_GML_WKB_ZFLAG               0x80000000
+#define OWS_GML_WKB_SRIDFLAG            0x20000000
+
+
+/*
+ * Decoder state for a single geometry
+ */
+typedef struct Ows_gml {
+  buffer * wkb;         /* raw EWKB bytes */
+  buffer * srsname;     /* root srsName, if any */
+  int srid;             /* srid written in root geometry, 0 if none */
+  int dim;              /* 2 or 3, from first coordinate found */
+  bool swap;            /* lat/long axis order to swap */
+} ows_gml;
+
+
+static bool ows_gml_geometry(ows_gml * g, xmlNodePtr n);
+
+
+/*
+ * Check if a node is a GML (3 or 3.2) element with the given name
+ */
+static bool ows_gml_is(xmlNodePtr n, const char *name)
+{
+  if (!n || n->type != XML_ELEMENT_NODE || !n->ns || !n->ns->href) return false;
+
+  if (    strcmp("http://www.opengis.net/gml",     (char *) n->ns->href)
+       && strcmp("http://www.opengis.net/gml/3.2", (char *) n->ns->href)) return false;
+
+  return !strcmp((char *) n->name, name);
+}
+
+
+/*
+ * Return first element child of a node, NULL if none
+ */
+static xmlNodePtr ows_gml_first_element(xmlNodePtr n)
+{
+  for (n = n->children ; n ; n = n->next)
+    if (n->type == XML_ELEMENT_NODE) return n;
+
+  return NULL;
+}
+
+
+/*
+ * Append raw bytes to the wkb buffer, in host byte order
+ */
+static void ows_gml_add_bytes(ows_gml * g, const void *p, size_t size)
+{
+  const unsigned char *c;
+  size_t i;
+
+  for (c = p, i = 0 ; i < size ; i++) buffer_add(g->wkb, (char) c[i]);
+}
+
+
+static void ows_gml_add_uint32(ows_gml * g, unsigned int v)
+{
+  ows_gml_add_bytes(g, &v, sizeof(unsigned int));
+}
+
+
+/*
+ * Overwrite a previously reserved uint32 (i.e a count) at a given offset
+ */
+static void ows_gml_set_uint32(ows_gml * g, size_t offset, unsigned int v)
+{
+  assert(offset + sizeof(unsigned int) <= g->wkb->use);
+  memcpy(g->wkb->buf + offset, &v, sizeof(unsigned int));
+}
+
+
+/*
+ * Write a geometry header: byte order, type (with flags) and srid
+ * srid is only written for the root geometry
+ */
+static void ows_gml_add_header(ows_gml * g, unsigned int type)
+{
+  unsigned int one = 1;
+
+  /* 1 is NDR (little endian), 0 XDR: we always write in host order */
+  buffer_add(g->wkb, *((char *) &one) ? 1 : 0);
+
+  if (g->dim == 3) type |= OWS_GML_WKB_ZFLAG;
+  if (g->wkb->use == 1 && g->srid > 0) {
+    ows_gml_add_uint32(g, type | OWS_GML_WKB_SRIDFLAG);
+    ows_gml_add_uint32(g, (unsigned int) g->srid);
+  } else ows_gml_add_uint32(g, type);
+}
+
+
+/*
+ * Write a coordinates tuple, swapping axis if needed
+ */
+static void ows_gml_add_point(ows_gml * g, double *p)
+{
+  if (g->swap) {
+    ows_gml_add_bytes(g, &p[1], sizeof(double));
+    ows_gml_add_bytes(g, &p[0], sizeof(double));
+  } else {
+    ows_gml_add_bytes(g, &p[0], sizeof(double));
+    ows_gml_add_bytes(g, &p[1], sizeof(double));
+  }
+
+  if (g->dim == 3) ows_gml_add_bytes(g, &p[2], sizeof(double));
+}
+
+
+/*
+ * Check srs dimension (2 or 3) against previous coordinates found
+ * Mixed dimensions geometries are left to PostGIS
+ */
+static bool ows_gml_set_dim(ows_gml * g, int dim)
+{
+  if (dim != 2 && dim != 3) return false;
+  if (!g->dim) g->dim = dim;
+
+  return g->dim == dim;
+}
+
+
+/*
+ * Retrieve srsDimension attribute from a node or its ancestors
+ * Default is 2
+ */
+static int ows_gml_srs_dimension(xmlNodePtr n)
+{
+  xmlChar *a;
+  int dim;
+
+  for (; n && n->type == XML_ELEMENT_NODE ; n = n->parent) {
+    a = xmlGetProp(n, (xmlChar *) "srsDimension");
+    if (!a) continue;
+
+    dim = atoi((char *) a);
+    xmlFree(a);
+    return dim;
+  }
+
+  return 2;
+}
+
+
+/*
+ * Parse one gml:coordinates tuple like "1,2" or "1,2,3"
+ * Move the pointer after the tuple, and return the number of values
+ * Return -1 on error
+ */
+static int ows_gml_parse_tuple(char **p, double *coords)
+{
+  char *end, *q;
+  int i;
+
+  for (i = 0 ; ; ) {
+    if (i == 3) return -1;
+
+    coords[i++] = strtod(*p, &end);
+    if (end == *p) return -1;
+
+    /* Whitespaces are allowed around ',' but are also tuples separator */
+    for (q = end ; isspace((unsigned char) *q) ; q++);
+    if (*q != ',') {
+      *p = end;
+      return i;
+    }
+    *p = q + 1;
+  }
+}
+
+
+/*
+ * Parse a whitespace separated list of doubles (gml:pos, gml:posList)
+ * Write them as points, and return the number of points written
+ * Return -1 on error
+ */
+static int ows_gml_add_pos(ows_gml * g, xmlNodePtr n, int dim)
+{
+  xmlChar *content;
+  char *p, *end;
+  double coords[3];
+  int i, npoints;
+
+  if (!ows_gml_set_dim(g, dim)) return -1;
+
+  content = xmlNodeGetContent(n);
+  if (!content) return -1;
+
+  for (p = (char *) content, i = 0, npoints = 0 ; ; ) {
+    while (isspace((unsigned char) *p)) p++;
+    if (!*p) break;
+
+    coords[i++] = strtod(p, &end);
+    if (end == p) {
+      xmlFree(content);
+      return -1;
+    }
+    p = end;
+
+    if (i == dim) {
+      ows_gml_add_point(g, coords);
+      npoints++;
+      i = 0;
+    }
+  }
+
+  xmlFree(content);
+
+  /* Truncated tuple */
+  if (i) return -1;
+
+  return npoints;
+}
+
+
+/*
+ * Count values in a gml:pos element, i.e its dimension
+ */
+static int ows_gml_pos_dimension(xmlNodePtr n)
+{
+  xmlChar *content;
+  char *p, *end;
+  int dim;
+
+  content = xmlNodeGetContent(n);
+  if (!content) return 0;
+
+  for (p = (char *) content, dim = 0 ; ; dim++, p = end) {
+    strtod(p, &end);
+    if (end == p) break;
+  }
+
+  xmlFree(content);
+  return dim;
+}
+
+
+/*
+ * Check that a gml:coordinates use default decimal, tuple and
+ * coordinates separators. Others are left to PostGIS
+ */
+static bool ows_gml_default_separators(xmlNodePtr n)
+{
+  xmlChar *a;
+  bool ret = true;
+
+  if ((a = xmlGetProp(n, (xmlChar *) "decimal"))) {
+    ret = ret && !strcmp((char *) a, ".");
+    xmlFree(a);
+  }
+  if ((a = xmlGetProp(n, (xmlChar *) "cs"))) {
+    ret = ret && !strcmp((char *) a, ",");
+    xmlFree(a);
+  }
+  if ((a = xmlGetProp(n, (xmlChar *) "ts"))) {
+    ret = ret && !strcmp((char *) a, " ");
+    xmlFree(a);
+  }
+
+  return ret;
+}
+
+
+/*
+ * Parse a GML 2 gml:coordinates content like "1,2 3,4"
+ * Return the number of points written, -1 on error
+ */
+static int ows_gml_add_coordinates(ows_gml * g, xmlNodePtr n)
+{
+  xmlChar *content;
+  char *p;
+  double coords[3];
+  int npoints;
+
+  if (!ows_gml_default_separators(n)) return -1;
+
+  content = xmlNodeGetContent(n);
+  if (!content) return -1;
+
+  for (p = (char *) content, npoints = 0 ; ; npoints++) {
+    while (isspace((unsigned char) *p)) p++;
+    if (!*p) break;
+
+    if (!ows_gml_set_dim(g, ows_gml_parse_tuple(&p, coords))) {
+      xmlFree(content);
+      return -1;
+    }
+
+    ows_gml_add_point(g, coords);
+  }
+
+  xmlFree(content);
+  return npoints;
+}
+
+
+/*
+ * Parse a GML 2 gml:coord element (X, Y and optional Z children)
+ * Return 1 on success, -1 on error
+ */
+static int ows_gml_add_coord(ows_gml * g, xmlNodePtr n)
+{
+  xmlChar *content;
+  double coords[3];
+  bool x = false, y = false, z = false;
+  char *end;
+
+  for (n = n->children ; n ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE) continue;
+
+    content = xmlNodeGetContent(n);
+    if (!content) return -1;
+
+    if (ows_gml_is(n, "X")) {
+      coords[0] = strtod((char *) content, &end);
+      x = true;
+    } else if (ows_gml_is(n, "Y")) {
+      coords[1] = strtod((char *) content, &end);
+      y = true;
+    } else if (ows_gml_is(n, "Z")) {
+      coords[2] = strtod((char *) content, &end);
+      z = true;
+    } else end = (char *) content;
+
+    if (end == (char *) content) {
+      xmlFree(content);
+      return -1;
+    }
+    xmlFree(content);
+  }
+
+  if (!x || !y || !ows_gml_set_dim(g, z ? 3 : 2)) return -1;
+
+  ows_gml_add_point(g, coords);
+  return 1;
+}
+
+
+/*
+ * Retrieve the dimension of the first coordinates found in a geometry
+ * As type flags are written before coordinates, we need it first
+ * Return 0 if none
+ */
+static int ows_gml_dimension(xmlNodePtr n)
+{
+  xmlNodePtr c;
+  xmlChar *content;
+  char *p;
+  double coords[3];
+  int dim;
+
+  if (ows_gml_is(n, "posList")) return ows_gml_srs_dimension(n);
+  if (ows_gml_is(n, "pos"))     return ows_gml_pos_dimension(n);
+
+  if (ows_gml_is(n, "coord")) {
+    for (c = n->children ; c ; c = c->next)
+      if (ows_gml_is(c, "Z")) return 3;
+    return 2;
+  }
+
+  if (ows_gml_is(n, "coordinates")) {
+    content = xmlNodeGetContent(n);
+    if (!content) return 0;
+    for (p = (char *) content ; isspace((unsigned char) *p) ; p++);
+    dim = ows_gml_parse_tuple(&p, coords);
+    xmlFree(content);
+    return dim > 0 ? dim : 0;
+  }
+
+  for (c = n->children ; c ; c = c->next) {
+    if (c->type != XML_ELEMENT_NODE) continue;
+    if ((dim = ows_gml_dimension(c))) return dim;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Write all points of a geometry node, with a count first if asked
+ * Points could come from gml:posList, gml:coordinates, or a serie of
+ * gml:pos or gml:coord elements
+ * Return the number of points written, -1 on error
+ */
+static int ows_gml_add_points(ows_gml * g, xmlNodePtr n, bool count)
+{
+  size_t offset;
+  int npoints, res;
+
+  offset = g->wkb->use;
+  if (count) ows_gml_add_uint32(g, 0);
+
+  for (npoints = 0, n = n->children ; n ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE) continue;
+
+    if      (ows_gml_is(n, "posList"))
+      res = ows_gml_add_pos(g, n, ows_gml_srs_dimension(n));
+    else if (ows_gml_is(n, "pos"))
+      res = ows_gml_add_pos(g, n, ows_gml_pos_dimension(n));
+    else if (ows_gml_is(n, "coordinates"))
+      res = ows_gml_add_coordinates(g, n);
+    else if (ows_gml_is(n, "coord"))
+      res = ows_gml_add_coord(g, n);
+    else res = -1;  /* pointProperty, pointRep... */
+
+    if (res < 0) return -1;
+    npoints += res;
+  }
+
+  if (count) ows_gml_set_uint32(g, offset, (unsigned int) npoints);
+  return npoints;
+}
+
+
+/*
+ * Write a LinearRing points, checking it's closed
+ */
+static bool ows_gml_add_ring(ows_gml * g, xmlNodePtr n)
+{
+  size_t offset, size;
+  int npoints;
+
+  if (!ows_gml_is(n, "LinearRing")) return false;
+
+  offset = g->wkb->use;
+  npoints = ows_gml_add_points(g, n, true);
+  if (npoints < 4) return false;
+
+  /* First and last points must be the same */
+  size = g->dim * sizeof(double);
+  offset += sizeof(unsigned int);
+
+  return !memcmp(g->wkb->buf + offset,
+                 g->wkb->buf + offset + (npoints - 1) * size, size);
+}
+
+
+static bool ows_gml_point(ows_gml * g, xmlNodePtr n)
+{
+  ows_gml_add_header(g, OWS_GML_WKB_POINT);
+
+  return ows_gml_add_points(g, n, false) == 1;
+}
+
+
+static bool ows_gml_linestring(ows_gml * g, xmlNodePtr n)
+{
+  ows_gml_add_header(g, OWS_GML_WKB_LINESTRING);
+
+  return ows_gml_add_points(g, n, true) >= 2;
+}
+
+
+/*
+ * As PostGIS does, a single LinearRing become a Polygon
+ */
+static bool ows_gml_linearring(ows_gml * g, xmlNodePtr n)
+{
+  ows_gml_add_header(g, OWS_GML_WKB_POLYGON);
+  ows_gml_add_uint32(g, 1);
+
+  return ows_gml_add_ring(g, n);
+}
+
+
+/*
+ * Polygon, GML 2 (outerBoundaryIs, innerBoundaryIs)
+ * or GML 3 (exterior, interior) flavour
+ */
+static bool ows_gml_polygon(ows_gml * g, xmlNodePtr n)
+{
+  xmlNodePtr c;
+  size_t offset;
+  unsigned int nrings = 0;
+
+  ows_gml_add_header(g, OWS_GML_WKB_POLYGON);
+  offset = g->wkb->use;
+  ows_gml_add_uint32(g, 0);
+
+  for (n = n->children ; n ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE) continue;
+
+    if (nrings == 0 && !ows_gml_is(n, "outerBoundaryIs")
+                    && !ows_gml_is(n, "exterior")) return false;
+    if (nrings  > 0 && !ows_gml_is(n, "innerBoundaryIs")
+                    && !ows_gml_is(n, "interior")) return false;
+
+    c = ows_gml_first_element(n);
+    if (!c || !ows_gml_add_ring(g, c)) return false;
+    nrings++;
+  }
+
+  if (!nrings) return false;
+
+  ows_gml_set_uint32(g, offset, nrings);
+  return true;
+}
+
+
+/*
+ * Multi geometries and collection
+ * member/members elements contain the sub geometries
+ */
+static bool ows_gml_multi(ows_gml * g, xmlNodePtr n, unsigned int type,
+                          const char *member, const char *members, const char *sub)
+{
+  xmlNodePtr c;
+  size_t offset;
+  unsigned int ngeoms = 0;
+
+  ows_gml_add_header(g, type);
+  offset = g->wkb->use;
+  ows_gml_add_uint32(g, 0);
+
+  for (n = n->children ; n ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE) continue;
+
+    if (ows_gml_is(n, member)) {
+      c = ows_gml_first_element(n);
+      if (!c) return false;
+      if (sub && !ows_gml_is(c, sub)) return false;
+      if (!ows_gml_geometry(g, c)) return false;
+      ngeoms++;
+
+    } else if (members && ows_gml_is(n, members)) {
+      for (c = n->children ; c ; c = c->next) {
+        if (c->type != XML_ELEMENT_NODE) continue;
+        if (sub && !ows_gml_is(c, sub)) return false;
+        if (!ows_gml_geometry(g, c)) return false;
+        ngeoms++;
+      }
+
+    } else return false;
+  }
+
+  if (!ngeoms) return false;
+
+  ows_gml_set_uint32(g, offset, ngeoms);
+  return true;
+}
+
+
+/*
+ * Decode a GML geometry node (root or nested)
+ */
+static bool ows_gml_geometry(ows_gml * g, xmlNodePtr n)
+{
+  xmlChar *a;
+  bool ret;
+
+  /* Shared geometries are left to PostGIS */
+  if ((a = xmlGetNsProp(n, (xmlChar *) "href", (xmlChar *) "http://www.w3.org/1999/xlink"))) {
+    xmlFree(a);
+    return false;
+  }
+
+  /* Nested srsName must match the root one (no reprojection here) */
+  if (g->wkb->use && (a = xmlGetProp(n, (xmlChar *) "srsName"))) {
+    ret = g->srsname && !strcmp((char *) a, g->srsname->buf);
+    xmlFree(a);
+    if (!ret) return false;
+  }
+
+  if      (ows_gml_is(n, "Point"))      return ows_gml_point(g, n);
+  else if (ows_gml_is(n, "LineString")) return ows_gml_linestring(g, n);
+  else if (ows_gml_is(n, "LinearRing")) return ows_gml_linearring(g, n);
+  else if (ows_gml_is(n, "Polygon"))    return ows_gml_polygon(g, n);
+
+  else if (ows_gml_is(n, "MultiPoint"))
+    return ows_gml_multi(g, n, OWS_GML_WKB_MULTIPOINT, "pointMember", "pointMembers", "Point");
+  else if (ows_gml_is(n, "MultiLineString"))
+    return ows_gml_multi(g, n, OWS_GML_WKB_MULTILINESTRING, "lineStringMember", NULL, "LineString");
+  else if (ows_gml_is(n, "MultiCurve"))
+    return ows_gml_multi(g, n, OWS_GML_WKB_MULTILINESTRING, "curveMember", "curveMembers", "LineString");
+  else if (ows_gml_is(n, "MultiPolygon"))
+    return ows_gml_multi(g, n, OWS_GML_WKB_MULTIPOLYGON, "polygonMember", NULL, "Polygon");
+  else if (ows_gml_is(n, "MultiSurface"))
+    return ows_gml_multi(g, n, OWS_GML_WKB_MULTIPOLYGON, "surfaceMember", "surfaceMembers", "Polygon");
+  else if (ows_gml_is(n, "MultiGeometry"))
+    return ows_gml_multi(g, n, OWS_GML_WKB_GEOMETRYCOLLECTION, "geometryMember", "geometryMembers", NULL);
+
+  /* Curve, Surface, Triangle, Tin, PolyhedralSurface... */
+  return false;
+}
+
+
+/*
+ * Retrieve the srs matching a srsName
+ * Last one is kept, as a whole Transaction use most of the time the same
+ */
+static ows_srs *ows_gml_srs(ows * o, const char *srsname)
+{
+  arena *prev;
+
+  assert(o);
+  assert(srsname);
+
+  if (o->gml_srsname && !strcmp(o->gml_srsname->buf, srsname)) return o->gml_srs;
+
+  /* Cache outlives the request, so keep it out of the arena */
+  prev = arena_use(NULL);
+
+  if (!o->gml_srsname) o->gml_srsname = buffer_init();
+  if (!o->gml_srs) o->gml_srs = ows_srs_init();
+  buffer_empty(o->gml_srsname);
+  buffer_empty(o->gml_srs->auth_name);
+
+  if (!ows_srs_set_from_srsname(o, o->gml_srs, srsname)) {
+    buffer_free(o->gml_srsname);
+    o->gml_srsname = NULL;
+    arena_use(prev);
+    return NULL;
+  }
+
+  buffer_add_str(o->gml_srsname, srsname);
+  arena_use(prev);
+
+  return o->gml_srs;
+}
+
+
+/*
+ * Transform a GML geometry to an hexadecimal EWKB string
+ * (i.e the same than ST_GeomFromGML output)
+ *
+ * If srid is not 0 and geometry have no srsName, srid is used
+ *
+ * Return NULL if geometry is not handled here or is not valid
+ * In such a case caller have to ask PostGIS
+ */
+buffer *ows_gml_to_ewkb(ows * o, xmlNodePtr n, int srid)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  ows_gml g;
+  ows_srs *srs;
+  xmlChar *a;
+  buffer *result;
+  size_t i;
+  bool ret;
+
+  assert(o);
+  assert(n);
+
+  g.wkb = buffer_init();
+  g.srsname = NULL;
+  g.srid = (ows_version_get(o->postgis_version) >= 200 && srid > 0) ? srid : 0;
+  g.dim = ows_gml_dimension(n);
+  g.swap = false;
+
+  if ((a = xmlGetProp(n, (xmlChar *) "srsName"))) {
+    /* PostGIS doesn't handle this one */
+    if (!strncmp((char *) a, "spatialreferencing.org", 22)) srs = NULL;
+    else srs = ows_gml_srs(o, (char *) a);
+
+    /* Reprojection to requested srid is left to PostGIS */
+    if (!srs || srs->srid <= 0 || (g.srid && g.srid != srs->srid)) {
+      xmlFree(a);
+      buffer_free(g.wkb);
+      return NULL;
+    }
+
+    g.srsname = buffer_from_str((char *) a);
+    g.srid = srs->srid;
+    g.swap = srs->is_reverse_axis && srs->is_degree;
+    xmlFree(a);
+  }
+
+  ret = ows_gml_geometry(&g, n);
+  if (g.srsname) buffer_free(g.srsname);
+
+  if (!ret) {
+    buffer_free(g.wkb);
+    return NULL;
+  }
+
+#if TINYOWS_GEOS
+  if (o->check_valid_geom) {
+    GEOSGeometry *geom;
+
+    geom = GEOSGeomFromWKB_buf_r(o->geos, (unsigned char *) g.wkb->buf, g.wkb->use);
+    ret = geom && GEOSisValid_r(o->geos, geom) == 1;
+    if (geom) GEOSGeom_destroy_r(o->geos, geom);
+
+    if (!ret) {
+      buffer_free(g.wkb);
+      return NULL;
+    }
+  }
+#endif
+
+  result = buffer_init();
+  buffer_reserve(result, g.wkb->use * 2);
+  for (i = 0 ; i < g.wkb->use ; i++) {
+    buffer_add(result, hex[((unsigned char) g.wkb->buf[i]) >> 4]);
+    buffer_add(result, hex[((unsigned char) g.wkb->buf[i]) & 0x0F]);
+  }
+
+  buffer_free(g.wkb);
+  return result;
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -87,6 +87,29 @@ bool ows_libxml_check_namespace(ows *o, xmlNodePtr n)
 }
 
 
+/*
+ * Same check, on a single element and its subtree
+ * (siblings of a streamed element are not parsed yet)
+ */
+bool ows_libxml_check_namespace_element(ows *o, xmlNodePtr n)
+{
+  xmlNsPtr *ns_doc;
+  bool ret;
+
+  assert(o);
+  assert(n);
+
+  ns_doc  = xmlGetNsList(n->doc, xmlDocGetRootElement(n->doc));
+  if (!ns_doc) return false;
+
+  ret = ows_libxml_check_namespace_node(o, n, ns_doc);
+  if (ret && n->children) ret = ows_libxml_check_namespace(o, n->children);
+
+  xmlFree(ns_doc);
+  return ret;
+}
+
+
 /*
  * vim: expandtab sw=4 ts=4
  */
@@ -0,0 +1,334 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+/*
+ * Log file
+ *
+ * Lines are formatted in memory, and written once the request is done
+ * (i.e after the response is flushed to the client) in a single write,
+ * so that logging stays off the request path and lines from several
+ * FastCGI workers don't interleave. Errors, and lines out of a request,
+ * are written right away.
+ * QUERY, SQL and TIMING levels could be sampled: only one request in n
+ * is then logged, all its lines of that level together.
+ */
+
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+#include "ows.h"
+
+
+/* Level names, by level bit */
+static const char *ows_log_names[OWS_LOG_LEVELS] = {
+  "ERROR", "EVENT", "QUERY", "SQL", "TIMING"
+};
+
+#define OWS_LOG_ALL ((1 << OWS_LOG_LEVELS) - 1)
+
+
+/*
+ * Initialize logger structure
+ */
+ows_logger *ows_logger_init()
+{
+  ows_logger *l;
+  int i;
+
+  l = malloc(sizeof(ows_logger));
+  assert(l);
+
+  l->file = NULL;
+  l->lines = buffer_init();
+  l->json = false;
+  l->defer = false;
+#ifndef _WIN32
+  l->pid = (long) getpid();
+#else
+  l->pid = (long) _getpid();
+#endif
+  l->request = 0;
+  for (i = 0 ; i < OWS_LOG_LEVELS ; i++) l->sampling[i] = 1;
+  l->sampled = OWS_LOG_ALL;
+  l->second = -1;
+  l->stamp[0] = '\0';
+
+  return l;
+}
+
+
+/*
+ * Release logger structure
+ */
+void ows_logger_free(ows_logger * l)
+{
+  assert(l);
+
+  if (l->file) fclose(l->file);
+  buffer_free(l->lines);
+  free(l);
+  l = NULL;
+}
+
+
+/*
+ * Set levels sampling, from a string like "SQL:10,TIMING:100"
+ * ERROR and EVENT are never sampled, unknown entries are ignored
+ */
+void ows_log_sampling(ows * o, const char *sampling)
+{
+  const char *p, *end;
+  size_t len;
+  int i, n;
+
+  assert(o && o->log);
+  assert(sampling);
+
+  for (p = sampling ; *p ; p = *end ? end + 1 : end) {
+    for (end = p ; *end && *end != ',' ; end++);
+    for (len = 0 ; p + len < end && p[len] != ':' ; len++);
+    if (p + len == end) continue;
+
+    n = atoi(p + len + 1);
+    if (n < 1) continue;
+
+    for (i = 2 ; i < OWS_LOG_LEVELS ; i++)
+      if (strlen(ows_log_names[i]) == len && !strncmp(ows_log_names[i], p, len))
+        o->log->sampling[i] = n;
+  }
+}
+
+
+/*
+ * A new request begins: number it, pick its sampled levels,
+ * and hold its lines until ows_log_flush
+ */
+void ows_log_request(ows * o)
+{
+  ows_logger *l;
+  int i;
+
+  assert(o && o->log);
+
+  l = o->log;
+  l->request++;
+  l->defer = true;
+
+  for (l->sampled = 0, i = 0 ; i < OWS_LOG_LEVELS ; i++)
+    if (l->sampling[i] <= 1 || (l->request - 1) % l->sampling[i] == 0)
+      l->sampled |= 1 << i;
+}
+
+
+/*
+ * Return true if a line of this level would be logged
+ * Allow callers to skip the build of costly messages
+ */
+bool ows_log_enabled(const ows * o, int log_level)
+{
+  assert(o && o->log);
+
+  return o->log_file && (o->log_level & o->log->sampled & log_level);
+}
+
+
+/*
+ * Refresh the cached stamp if second changed, return milliseconds
+ * Text lines keep ctime() local format, JSON ones are UTC ISO 8601
+ */
+static int ows_log_stamp(ows_logger * l)
+{
+  struct tm tm;
+  time_t t;
+  int ms;
+#ifndef _WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  t = ts.tv_sec;
+  ms = (int) (ts.tv_nsec / 1000000);
+#else
+  t = time(NULL);
+  ms = 0;
+#endif
+
+  if ((long) t == l->second) return ms;
+  l->second = (long) t;
+
+#ifndef _WIN32
+  if (l->json) gmtime_r(&t, &tm);
+  else         localtime_r(&t, &tm);
+#else
+  if (l->json) gmtime_s(&tm, &t);
+  else         localtime_s(&tm, &t);
+#endif
+
+  strftime(l->stamp, sizeof(l->stamp), l->json ? "%Y-%m-%dT%H:%M:%S" : "%a %b %e %H:%M:%S %Y", &tm);
+
+  return ms;
+}
+
+
+/*
+ * Add a string to a JSON line, escaped
+ */
+static void ows_log_json_str(buffer * b, const char *str)
+{
+  char hex[8];
+
+  for ( ; *str ; str++) {
+    switch (*str) {
+      case '"':  buffer_add_str(b, "\\\""); break;
+      case '\\': buffer_add_str(b, "\\\\"); break;
+      case '\n': buffer_add_str(b, "\\n");  break;
+      case '\r': buffer_add_str(b, "\\r");  break;
+      case '\t': buffer_add_str(b, "\\t");  break;
+      default:
+        if ((unsigned char) *str < 0x20) {
+          sprintf(hex, "\\u%04x", (unsigned char) *str);
+          buffer_add_str(b, hex);
+        } else buffer_add(b, *str);
+    }
+  }
+}
+
+
+/*
+ * Write pending lines at once, opening log file if needed
+ */
+static void ows_log_write(ows * o)
+{
+  ows_logger *l;
+
+  l = o->log;
+  if (!l->lines->use) return;
+
+  if (!l->file) {
+    l->file = fopen(o->log_file->buf, "a");
+    if (l->file) setvbuf(l->file, NULL, _IONBF, 0);
+  }
+
+  if (l->file) fwrite(l->lines->buf, 1, l->lines->use, l->file);
+  buffer_empty(l->lines);
+}
+
+
+/*
+ * Log a line, with extra fields for JSON lines
+ * Fields are JSON members, like "ms":1.5,"rows":10 (ignored by text lines)
+ */
+void ows_log_fields(ows * o, int log_level, const char *log, const char *fields)
+{
+  ows_logger *l;
+  arena *prev;
+  char ms[8];
+  int i;
+
+  assert(o);
+  assert(log);
+
+  if (!ows_log_enabled(o, log_level)) return;
+
+  l = o->log;
+  for (i = 0 ; !(log_level & (1 << i)) ; i++);
+
+  /* Lines outlive the request, so keep them out of the arena */
+  prev = arena_use(NULL);
+
+  sprintf(ms, ".%03d", ows_log_stamp(l));
+
+  if (l->json) {
+    buffer_add_str(l->lines, "{\"time\":\"");
+    buffer_add_str(l->lines, l->stamp);
+    buffer_add_str(l->lines, ms);
+    buffer_add_str(l->lines, "Z\",\"level\":\"");
+    buffer_add_str(l->lines, ows_log_names[i]);
+    buffer_add_str(l->lines, "\",\"pid\":");
+    buffer_add_long(l->lines, l->pid);
+    if (l->defer) {
+      buffer_add_str(l->lines, ",\"request\":");
+      buffer_add_long(l->lines, (long) l->request);
+    }
+    buffer_add_str(l->lines, ",\"msg\":\"");
+    ows_log_json_str(l->lines, log);
+    buffer_add(l->lines, '"');
+    if (fields && *fields) {
+      buffer_add(l->lines, ',');
+      buffer_add_str(l->lines, fields);
+    }
+    buffer_add_str(l->lines, "}\n");
+  } else {
+    buffer_add(l->lines, '[');
+    buffer_add_str(l->lines, l->stamp);
+    buffer_add_str(l->lines, "] [");
+    buffer_add_str(l->lines, ows_log_names[i]);
+    buffer_add_str(l->lines, "] ");
+    buffer_add_str(l->lines, log);
+    buffer_add(l->lines, '\n');
+  }
+
+  if (!l->defer || (log_level & 1) || l->lines->use >= OWS_LOG_BUFFER_SIZE) ows_log_write(o);
+  arena_use(prev);
+}
+
+
+/*
+ * Log a line
+ */
+void ows_log(ows *o, int log_level, const char *log)
+{
+  ows_log_fields(o, log_level, log, NULL);
+}
+
+
+/*
+ * The request is done: write its lines, log all levels again until the next one
+ */
+void ows_log_flush(ows * o)
+{
+  assert(o && o->log);
+
+  if (o->log_file) ows_log_write(o);
+
+  o->log->defer = false;
+  o->log->sampled = OWS_LOG_ALL;
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -0,0 +1,335 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+/*
+ * In process metrics, in Prometheus text format
+ *
+ * Each request is accounted, once done, under its operation, output
+ * format and layer: count, duration histogram, SQL round trips and
+ * time, rendered rows. Errors are counted by code.
+ * A process serves one request at a time, so plain counters are enough.
+ * With FastCGI each worker has its own counters, told apart by the pid
+ * label: sum them on the Prometheus side.
+ */
+
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+#include "ows.h"
+
+
+/* Upper bounds of duration buckets, in seconds */
+static const double ows_metrics_bounds[OWS_METRICS_BUCKETS] = {
+  0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+};
+
+
+/*
+ * Initialize metrics structure
+ */
+ows_metrics *ows_metrics_init()
+{
+  ows_metrics *m;
+
+  m = malloc(sizeof(ows_metrics));
+  assert(m);
+
+  memset(m, 0, sizeof(ows_metrics));
+  m->start = ows_time();
+#ifndef _WIN32
+  m->pid = (long) getpid();
+#else
+  m->pid = (long) _getpid();
+#endif
+  m->index = hash_init(false);
+
+  return m;
+}
+
+
+/*
+ * Release metrics structure
+ */
+void ows_metrics_free(ows_metrics * m)
+{
+  ows_metrics_entry *e, *next;
+
+  assert(m);
+
+  for (e = m->first ; e ; e = next) {
+    next = e->next;
+    buffer_free(e->labels);
+    free(e);
+  }
+
+  hash_free(m->index);
+  free(m);
+  m = NULL;
+}
+
+
+static const char *ows_metrics_operation(enum wfs_request request)
+{
+  switch (request) {
+    case WFS_GET_CAPABILITIES:      return "GetCapabilities";
+    case WFS_DESCRIBE_FEATURE_TYPE: return "DescribeFeatureType";
+    case WFS_GET_FEATURE:           return "GetFeature";
+    case WFS_TRANSACTION:           return "Transaction";
+    default:                        return "unknown";
+  }
+}
+
+
+static const char *ows_metrics_format(enum wfs_format format)
+{
+  switch (format) {
+    case WFS_XML_SCHEMA:       return "XMLSCHEMA";
+    case WFS_GML212:           return "GML2";
+    case WFS_GML311:           return "GML3";
+    case WFS_GML321:           return "GML32";
+    case WFS_GEOJSON:          return "GeoJSON";
+    case WFS_JSONP:            return "JSONP";
+    case WFS_TEXT_XML:         return "text/xml";
+    case WFS_APPLICATION_XML:  return "application/xml";
+    default:                   return "unknown";
+  }
+}
+
+
+/*
+ * Add a label to a Prometheus label set, escaping its value
+ */
+static void ows_metrics_label(buffer * b, const char *name, const char *value)
+{
+  if (b->use) buffer_add(b, ',');
+  buffer_add_str(b, name);
+  buffer_add_str(b, "=\"");
+
+  for ( ; *value ; value++) {
+    if      (*value == '\\') buffer_add_str(b, "\\\\");
+    else if (*value == '"')  buffer_add_str(b, "\\\"");
+    else if (*value == '\n') buffer_add_str(b, "\\n");
+    else                     buffer_add(b, *value);
+  }
+
+  buffer_add(b, '"');
+}
+
+
+/*
+ * Select the entry the current request will be accounted to
+ * Must be called while request structures are still there
+ * Layer is only a label if it is a known one, so that label sets
+ * stay bounded whatever clients ask
+ */
+void ows_metrics_select(ows * o)
+{
+  ows_metrics_entry *e;
+  wfs_request *wr;
+  buffer *labels;
+  arena *prev;
+
+  assert(o && o->metrics);
+
+  wr = o->request ? o->request->request.wfs : NULL;
+
+  labels = buffer_init();
+  ows_metrics_label(labels, "operation", wr ? ows_metrics_operation(wr->request) : "unknown");
+  ows_metrics_label(labels, "format", wr ? ows_metrics_format(wr->format) : "unknown");
+  if (wr && wr->typename && wr->typename->size == 1
+      && ows_layer_prefix_to_uri(o->layers, wr->typename->first->value))
+    ows_metrics_label(labels, "layer", wr->typename->first->value->buf);
+  else
+    ows_metrics_label(labels, "layer", "");
+
+  e = hash_get(o->metrics->index, labels->buf);
+
+  if (!e) {
+    /* Metrics outlive the request, so keep them out of the arena */
+    prev = arena_use(NULL);
+
+    e = malloc(sizeof(ows_metrics_entry));
+    assert(e);
+    memset(e, 0, sizeof(ows_metrics_entry));
+    e->labels = buffer_init();
+    buffer_copy(e->labels, labels);
+
+    hash_add(o->metrics->index, e->labels, e);
+    if (!o->metrics->first) o->metrics->first = e;
+    else                    o->metrics->last->next = e;
+    o->metrics->last = e;
+
+    arena_use(prev);
+  }
+
+  buffer_free(labels);
+  o->metrics->current = e;
+}
+
+
+/*
+ * Account the request just done, with its timing
+ */
+void ows_metrics_record(ows * o)
+{
+  ows_metrics_entry *e;
+  double seconds;
+  int i;
+
+  assert(o && o->metrics);
+
+  e = o->metrics->current;
+  if (!e) return;
+
+  seconds = ows_time() - o->timing.start;
+  for (i = 0 ; i < OWS_METRICS_BUCKETS && seconds > ows_metrics_bounds[i] ; i++);
+  if (i < OWS_METRICS_BUCKETS) e->buckets[i]++;
+
+  e->requests++;
+  e->seconds += seconds;
+  e->sql += o->timing.sql;
+  e->sql_seconds += o->timing.phase[OWS_TIMING_SQL];
+  e->rows += o->timing.rows;
+
+  o->metrics->current = NULL;
+}
+
+
+/*
+ * Check if the request is an allowed Metrics one:
+ * SERVICE=TINYOWS&REQUEST=Metrics&TOKEN=... with the configured token
+ * Otherwise request goes on as usual (and so is an unknown service)
+ */
+bool ows_metrics_is_request(ows * o, const array * cgi)
+{
+  assert(o);
+
+  if (!o->metrics_token || !cgi) return false;
+
+  return    array_is_key(cgi, "service") && buffer_case_cmp(array_get(cgi, "service"), "TINYOWS")
+         && array_is_key(cgi, "request") && buffer_case_cmp(array_get(cgi, "request"), "Metrics")
+         && array_is_key(cgi, "token")   && buffer_cmp(array_get(cgi, "token"), o->metrics_token->buf);
+}
+
+
+/*
+ * Write a metric header
+ */
+static void ows_metrics_help(ows * o, const char *name, const char *type, const char *help)
+{
+  fprintf(o->output, "# HELP %s %s\n", name, help);
+  fprintf(o->output, "# TYPE %s %s\n", name, type);
+}
+
+
+/*
+ * Write all metrics, in Prometheus text format
+ */
+void ows_metrics_report(ows * o)
+{
+  ows_metrics_entry *e;
+  ows_metrics *m;
+  unsigned long cumul;
+  int i;
+
+  assert(o && o->metrics);
+
+  m = o->metrics;
+
+  ows_timing_header(o);
+  fprintf(o->output, "Content-Type: text/plain; version=0.0.4\n\n");
+
+  ows_metrics_help(o, "tinyows_requests_total", "counter",
+                   "Requests served, by operation, output format and layer.");
+  for (e = m->first ; e ; e = e->next)
+    fprintf(o->output, "tinyows_requests_total{pid=\"%ld\",%s} %lu\n", m->pid, e->labels->buf, e->requests);
+
+  ows_metrics_help(o, "tinyows_request_duration_seconds", "histogram",
+                   "Requests duration, from query read to response flushed.");
+  for (e = m->first ; e ; e = e->next) {
+    for (i = 0, cumul = 0 ; i < OWS_METRICS_BUCKETS ; i++) {
+      cumul += e->buckets[i];
+      fprintf(o->output, "tinyows_request_duration_seconds_bucket{pid=\"%ld\",%s,le=\"%g\"} %lu\n",
+              m->pid, e->labels->buf, ows_metrics_bounds[i], cumul);
+    }
+    fprintf(o->output, "tinyows_request_duration_seconds_bucket{pid=\"%ld\",%s,le=\"+Inf\"} %lu\n",
+            m->pid, e->labels->buf, e->requests);
+    fprintf(o->output, "tinyows_request_duration_seconds_sum{pid=\"%ld\",%s} %.6f\n",
+            m->pid, e->labels->buf, e->seconds);
+    fprintf(o->output, "tinyows_request_duration_seconds_count{pid=\"%ld\",%s} %lu\n",
+            m->pid, e->labels->buf, e->requests);
+  }
+
+  ows_metrics_help(o, "tinyows_sql_queries_total", "counter", "Database round trips.");
+  for (e = m->first ; e ; e = e->next)
+    fprintf(o->output, "tinyows_sql_queries_total{pid=\"%ld\",%s} %lu\n", m->pid, e->labels->buf, e->sql);
+
+  ows_metrics_help(o, "tinyows_sql_seconds_total", "counter", "Time spent waiting for the database.");
+  for (e = m->first ; e ; e = e->next)
+    fprintf(o->output, "tinyows_sql_seconds_total{pid=\"%ld\",%s} %.6f\n", m->pid, e->labels->buf, e->sql_seconds);
+
+  ows_metrics_help(o, "tinyows_rows_total", "counter", "Features rendered.");
+  for (e = m->first ; e ; e = e->next)
+    fprintf(o->output, "tinyows_rows_total{pid=\"%ld\",%s} %lu\n", m->pid, e->labels->buf, e->rows);
+
+  ows_metrics_help(o, "tinyows_errors_total", "counter", "Exception reports sent, by code.");
+  for (i = 0 ; i <= OWS_ERROR_REQUEST_TOO_LARGE ; i++)
+    if (m->ows_errors[i])
+      fprintf(o->output, "tinyows_errors_total{pid=\"%ld\",type=\"ows\",code=\"%s\"} %lu\n",
+              m->pid, ows_error_code_string(i), m->ows_errors[i]);
+  for (i = 0 ; i <= WFS_ERROR_MISSING_PARAMETER ; i++)
+    if (m->wfs_errors[i])
+      fprintf(o->output, "tinyows_errors_total{pid=\"%ld\",type=\"wfs\",code=\"%s\"} %lu\n",
+              m->pid, wfs_error_code_string(i), m->wfs_errors[i]);
+
+  ows_metrics_help(o, "tinyows_filter_cache_hits_total", "counter", "Filters taken from the filter cache.");
+  fprintf(o->output, "tinyows_filter_cache_hits_total{pid=\"%ld\"} %lu\n", m->pid,
+          o->filter_cache ? o->filter_cache->hits : 0);
+  ows_metrics_help(o, "tinyows_filter_cache_misses_total", "counter", "Filters compiled, not found in the filter cache.");
+  fprintf(o->output, "tinyows_filter_cache_misses_total{pid=\"%ld\"} %lu\n", m->pid,
+          o->filter_cache ? o->filter_cache->misses : 0);
+  ows_metrics_help(o, "tinyows_filter_cache_entries", "gauge", "Filters in the filter cache.");
+  fprintf(o->output, "tinyows_filter_cache_entries{pid=\"%ld\"} %lu\n", m->pid,
+          o->filter_cache ? (unsigned long) o->filter_cache->count : 0);
+
+  ows_metrics_help(o, "tinyows_uptime_seconds", "gauge", "Time since the process started.");
+  fprintf(o->output, "tinyows_uptime_seconds{pid=\"%ld\"} %.3f\n", m->pid, ows_time() - m->start);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -25,8 +25,15 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
 #include "ows.h"
 
 
@@ -50,23 +57,238 @@ buffer *ows_psql_id_column(ows * o, buffer * layer_name)
 }
 
 
+/*
+ * Log an executed SQL request, with its duration and rows
+ */
+static void ows_psql_log(ows * o, const char *sql, double start, const PGresult * res)
+{
+  char fields[64];
+
+  if (!ows_log_enabled(o, 8)) return;
+
+  sprintf(fields, "\"ms\":%.3f,\"rows\":%d", (ows_time() - start) * 1000.0, PQntuples(res));
+  ows_log_fields(o, 8, sql, fields);
+}
+
+
 /*
  * Execute an SQL request
  */
 PGresult * ows_psql_exec(ows *o, const char *sql)
 {
   PGresult* res;
+  double start;
 
   assert(o);
   assert(sql);
   assert(o->pg);
 
-  ows_log(o, 8, sql);
+  start = ows_time();
   res = PQexecParams(o->pg, sql, 0, NULL, NULL, NULL, NULL, 0);
+  ows_timing_add(o, OWS_TIMING_SQL, start);
+  o->timing.sql++;
+  ows_psql_log(o, sql, start, res);
+  if (strlen(PQresultErrorMessage(res)))
+    ows_log(o, 1, PQresultErrorMessage(res));
+
+  return res;
+}
+
+
+/*
+ * Execute a COPY ... FROM STDIN request, streaming data to the server
+ * Data must already be in COPY text format (one line per row)
+ * Return the final result of the request
+ */
+PGresult *ows_psql_copy(ows * o, const char *sql, const buffer * data)
+{
+  PGresult *res, *next;
+  double start;
+
+  assert(o);
+  assert(o->pg);
+  assert(sql);
+  assert(data);
+
+  start = ows_time();
+  o->timing.sql++;
+  res = PQexec(o->pg, sql);
+
+  if (PQresultStatus(res) == PGRES_COPY_IN) {
+    PQclear(res);
+
+    if (PQputCopyData(o->pg, data->buf, (int) data->use) == 1)
+      PQputCopyEnd(o->pg, NULL);
+    else
+      PQputCopyEnd(o->pg, "Unable to send COPY data");
+
+    res = PQgetResult(o->pg);
+    while ((next = PQgetResult(o->pg))) PQclear(next);
+  }
+  ows_timing_add(o, OWS_TIMING_SQL, start);
+  ows_psql_log(o, sql, start, res);
+
+  if (strlen(PQresultErrorMessage(res)))
+    ows_log(o, 1, PQresultErrorMessage(res));
+
+  return res;
+}
+
+
+#ifdef LIBPQ_HAS_PIPELINING
+/*
+ * Flush the pipeline output buffer on a non blocking connection
+ * While server can't take more requests, its pending results are read,
+ * so neither side could wait forever on a full socket buffer
+ * Return false if connection was lost
+ */
+static bool ows_psql_pipeline_flush(ows * o)
+{
+  fd_set rfds, wfds;
+  int sock, ret;
+
+  while ((ret = PQflush(o->pg)) == 1) {
+    sock = PQsocket(o->pg);
+    if (sock < 0) return false;
+
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(sock, &rfds);
+    FD_SET(sock, &wfds);
+
+    if (select(sock + 1, &rfds, &wfds, NULL, NULL) < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+
+    if (FD_ISSET(sock, &rfds) && !PQconsumeInput(o->pg)) return false;
+  }
+
+  return ret == 0;
+}
+#endif
+
+
+/*
+ * Send a list of SQL requests at once, using libpq pipeline mode
+ * so requests are streamed to the server without waiting for each result
+ * Results are then retrieved in order with ows_psql_pipeline_result,
+ * and pipeline closed with ows_psql_pipeline_end
+ * Return the number of requests sent (less than asked if connection
+ * failed), or -1 if pipeline mode is not available (libpq < 14)
+ */
+int ows_psql_pipeline_begin(ows * o, const list * sql)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+  list_node *ln;
+  double start;
+  int sent = 0;
+
+  assert(o);
+  assert(o->pg);
+  assert(sql);
+
+  if (!PQenterPipelineMode(o->pg)) return -1;
+
+  /* All requests make a single round trip */
+  start = ows_time();
+  o->timing.sql++;
+
+  /* Non blocking while sending: server could stop reading requests
+     until we read its results */
+  PQsetnonblocking(o->pg, 1);
+
+  for (ln = sql->first ; ln ; ln = ln->next) {
+    ows_log(o, 8, ln->value->buf);
+    if (!PQsendQueryParams(o->pg, ln->value->buf, 0, NULL, NULL, NULL, NULL, 0)
+        || !ows_psql_pipeline_flush(o)) break;
+    sent++;
+  }
+
+  /* Without a sync point, no result could be waited for */
+  if (PQpipelineSync(o->pg)) ows_psql_pipeline_flush(o);
+  else sent = 0;
+
+  /* Results are read in blocking mode */
+  PQsetnonblocking(o->pg, 0);
+  ows_timing_add(o, OWS_TIMING_SQL, start);
+
+  return sent;
+#else
+  assert(o);
+  assert(sql);
+
+  return -1;
+#endif
+}
+
+
+/*
+ * Retrieve the next request result from a pipeline
+ * Return NULL if connection was lost before result was received
+ */
+PGresult *ows_psql_pipeline_result(ows * o)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+  PGresult *res, *next;
+  double start;
+
+  assert(o);
+  assert(o->pg);
+
+  start = ows_time();
+  res = PQgetResult(o->pg);
+  if (!res) return NULL;
+
+  /* Each request results are ended by a NULL one */
+  while ((next = PQgetResult(o->pg))) PQclear(next);
+  ows_timing_add(o, OWS_TIMING_SQL, start);
+
   if (strlen(PQresultErrorMessage(res)))
     ows_log(o, 1, PQresultErrorMessage(res));
 
   return res;
+#else
+  assert(o);
+
+  return NULL;
+#endif
+}
+
+
+/*
+ * Consume remaining results (if any) and leave pipeline mode
+ */
+void ows_psql_pipeline_end(ows * o)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+  PGresult *res;
+  ExecStatusType status;
+  bool previous_null = false;
+
+  assert(o);
+  assert(o->pg);
+
+  /* Two NULL results in a row means nothing else is pending */
+  while (PQstatus(o->pg) == CONNECTION_OK) {
+    res = PQgetResult(o->pg);
+
+    if (!res) {
+      if (previous_null) break;
+      previous_null = true;
+      continue;
+    }
+
+    previous_null = false;
+    status = PQresultStatus(res);
+    PQclear(res);
+    if (status == PGRES_PIPELINE_SYNC) break;
+  }
+
+  PQexitPipelineMode(o->pg);
+#else
+  assert(o);
+#endif
 }
 
 
@@ -528,6 +750,114 @@ buffer *ows_psql_timestamp_to_xml_time(char *timestamp)
 }
 
 
+/*
+ * Write a value as is
+ */
+static void ows_psql_encode_raw(FILE * output, const char * value)
+{
+  fputs(value, output);
+}
+
+
+/*
+ * Write a text value, with XML entities encoded
+ */
+static void ows_psql_encode_text(FILE * output, const char * value)
+{
+  buffer_fputs_xml_entities(value, output);
+}
+
+
+/*
+ * Write a PostgreSQL boolean as a XML one
+ */
+static void ows_psql_encode_bool(FILE * output, const char * value)
+{
+  if (!strcmp(value, "t")) fputs("true", output);
+  if (!strcmp(value, "f")) fputs("false", output);
+}
+
+
+/*
+ * Write a PostgreSQL timestamp as a XML dateTime
+ * Same output than ows_psql_timestamp_to_xml_time(), without any allocation
+ */
+static void ows_psql_encode_timestamp(FILE * output, const char * value)
+{
+  bool tz = false;
+
+  for (/* empty */ ; *value ; value++) {
+    if (*value == '+') tz = true;
+    putc(*value == ' ' ? 'T' : *value, output);
+  }
+
+  fputs(tz ? ":00" : "Z", output);
+}
+
+
+static const ows_psql_type_info ows_psql_types[] = {
+  { OWS_PSQL_TYPE_OTHER,     ows_psql_encode_raw },
+  { OWS_PSQL_TYPE_TEXT,      ows_psql_encode_text },
+  { OWS_PSQL_TYPE_NUMERIC,   ows_psql_encode_raw },
+  { OWS_PSQL_TYPE_BOOL,      ows_psql_encode_bool },
+  { OWS_PSQL_TYPE_TIMESTAMP, ows_psql_encode_timestamp }
+};
+
+
+/*
+ * Resolve a PostgreSQL type name into its type info
+ */
+const ows_psql_type_info *ows_psql_type_info_from_name(const buffer * type)
+{
+  assert(type);
+
+  if (    buffer_cmp(type, "timestamptz")
+       || buffer_cmp(type, "timestamp")
+       || buffer_cmp(type, "datetime")
+       || buffer_cmp(type, "date"))
+    return &ows_psql_types[OWS_PSQL_TYPE_TIMESTAMP];
+
+  if (buffer_cmp(type, "bool")) return &ows_psql_types[OWS_PSQL_TYPE_BOOL];
+
+  if (    buffer_cmp(type, "text")
+       || buffer_cmp(type, "hstore")
+       || buffer_ncmp(type, "char", 4)
+       || buffer_ncmp(type, "varchar", 7))
+    return &ows_psql_types[OWS_PSQL_TYPE_TEXT];
+
+  if (ows_psql_is_numeric((buffer *) type)) return &ows_psql_types[OWS_PSQL_TYPE_NUMERIC];
+
+  return &ows_psql_types[OWS_PSQL_TYPE_OTHER];
+}
+
+
+/*
+ * Return the type info of the property passed in parameter,
+ * as resolved when storage was filled
+ */
+const ows_psql_type_info *ows_psql_type_info_get(ows * o, buffer * layer_name, const char * property)
+{
+  ows_layer_node *ln;
+  const ows_psql_type_info *info;
+
+  assert(o);
+  assert(o->layers);
+  assert(layer_name);
+  assert(property);
+
+  for (ln = o->layers->first ; ln ; ln = ln->next) {
+    if (ln->layer->name && ln->layer->storage
+        && !strcmp(ln->layer->name->buf, layer_name->buf)) {
+      info = hash_get(ln->layer->storage->attributes_type, property);
+      if (info) return info;
+      break;
+    }
+  }
+
+  return &ows_psql_types[OWS_PSQL_TYPE_OTHER];
+}
+
+
 /*
  * Return the type of the property passed in parameter
  */
@@ -550,6 +880,27 @@ buffer *ows_psql_type(ows * o, buffer * layer_name, buffer * property)
 }
 
 
+/*
+ * Return the DEFAULT value of the id column of a given layer, if any,
+ * so PostgreSQL is able to generate itself a new id on INSERT
+ */
+buffer *ows_psql_id_default(ows * o, buffer * layer_name)
+{
+  ows_layer_node *ln = NULL;
+
+  assert(o);
+  assert(o->layers);
+  assert(layer_name);
+
+  for (ln = o->layers->first ; ln ; ln = ln->next)
+    if (ln->layer->name && ln->layer->storage
+        && !strcmp(ln->layer->name->buf, layer_name->buf))
+      return ln->layer->storage->pkey_default;
+
+  return NULL;
+}
+
+
 /*
  * Generate a new buffer id supposed to be unique for a given layer name
  */
@@ -747,6 +1098,8 @@ static xmlNodePtr ows_psql_recursive_parse_gml(ows * o, xmlNodePtr n, xmlNodePtr
 
 /*
  * Transform a GML geometry to PostGIS EWKT
+ * Simple Features geometries are decoded locally,
+ * others are parsed by PostGIS
  * Return NULL on error
  */
 buffer * ows_psql_gml_to_sql(ows * o, xmlNodePtr n, int srid)
@@ -761,37 +1114,47 @@ buffer * ows_psql_gml_to_sql(ows * o, xmlNodePtr n, int srid)
   g = ows_psql_recursive_parse_gml(o, n, NULL);
   if (!g) return NULL;    /* No Geometry founded in GML doc */
 
-  /* Retrieve the sub doc and launch GML parse via PostGIS */
-  gml = buffer_init();
-  cgi_add_xml_into_buffer(gml, g);
+  result = ows_gml_to_ewkb(o, g, srid);
+
+#if TINYOWS_GEOS
+  /* Validity already checked by GEOS */
+  if (result) return result;
+#endif
 
   sql = buffer_init();
-  buffer_add_str(sql, "SELECT ST_GeomFromGML('");
-  buffer_add_str(sql, gml->buf);
-
-  if (ows_version_get(o->postgis_version) >= 200) {
-    buffer_add_str(sql, "',");
-    buffer_add_int(sql, srid);
-    buffer_add_str(sql, ")");
-  } else {
-    /* Means PostGIS 1.5 */
-    buffer_add_str(sql, "')");
-  }
 
-  res = ows_psql_exec(o, sql->buf);
-  buffer_free(gml);
+  if (!result) {
+    /* Retrieve the sub doc and launch GML parse via PostGIS */
+    gml = buffer_init();
+    cgi_add_xml_into_buffer(gml, g);
+
+    buffer_add_str(sql, "SELECT ST_GeomFromGML('");
+    buffer_add_str(sql, gml->buf);
+
+    if (ows_version_get(o->postgis_version) >= 200) {
+      buffer_add_str(sql, "',");
+      buffer_add_int(sql, srid);
+      buffer_add_str(sql, ")");
+    } else {
+      /* Means PostGIS 1.5 */
+      buffer_add_str(sql, "')");
+    }
 
-  /* GML Parse errors cases */
-  if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1) {
-    buffer_free(sql);
+    res = ows_psql_exec(o, sql->buf);
+    buffer_free(gml);
+
+    /* GML Parse errors cases */
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1) {
+      buffer_free(sql);
+      PQclear(res);
+      return NULL;
+    }
+
+    result = buffer_init();
+    buffer_add_str(result, PQgetvalue(res, 0, 0));
     PQclear(res);
-    return NULL;
   }
 
-  result = buffer_init();
-  buffer_add_str(result, PQgetvalue(res, 0, 0));
-  PQclear(res);
-
   /* Check if geometry is valid */
   if (o->check_valid_geom) {
 
@@ -45,6 +45,8 @@ ows_request *ows_request_init()
   or->version = NULL;
   or->service = OWS_SERVICE_UNKNOWN;
   or->method = OWS_METHOD_UNKNOWN;
+  or->body = NULL;
+  or->doc = NULL;
   or->request.wfs = NULL;
 
   return or;
@@ -70,6 +72,9 @@ void ows_request_free(ows_request * or)
       assert(0); /* Should not happen */
   }
 
+  /* Last one, as request structures could point into it */
+  if (or->doc) xmlFreeDoc(or->doc);
+
   free(or);
   or = NULL;
 }
@@ -149,57 +154,79 @@ static xmlSchemaPtr ows_generate_schema(const ows *o, buffer * xml_schema, bool
 
 
 /*
- * Valid an xml string against an XML schema
+ * Valid an xml document against an XML schema
  */
-int ows_schema_validation(ows *o, buffer *xml_schema, buffer *xml, bool schema_is_file, enum ows_schema_type schema_type)
+int ows_schema_validation(ows *o, xmlSchemaPtr schema, xmlDocPtr doc)
 {
-  xmlSchemaPtr schema;
   xmlSchemaValidCtxtPtr schema_ctx;
-  xmlDocPtr doc;
   int ret = -1;
-  bool schema_generate = true;
 
   assert(o);
-  assert(xml);
-  assert(xml_schema);
+  assert(doc);
 
-  doc = xmlParseMemory(xml->buf, xml->use);
-  if (!doc) return ret;
-  if (!ows_libxml_check_namespace(o, doc->children)) {
-    xmlFreeDoc(doc);
-    return ret;
-  }
-
-  if (schema_type == WFS_SCHEMA_TYPE_100 && o->schema_wfs_100) {
-    schema_generate = false;
-    schema = o->schema_wfs_100;
-  } else if (schema_type == WFS_SCHEMA_TYPE_110 && o->schema_wfs_110) {
-    schema_generate = false;
-    schema = o->schema_wfs_110;
-  }
-
-  if (schema_generate) schema = ows_generate_schema(o, xml_schema, schema_is_file);
-  if (!schema) {
-    xmlFreeDoc(doc);
-    return ret;
-  }
+  if (!schema) return ret;
+  if (!ows_libxml_check_namespace(o, doc->children)) return ret;
 
   schema_ctx = xmlSchemaNewValidCtxt(schema);
-  xmlSchemaSetValidErrors(schema_ctx,
-                          (xmlSchemaValidityErrorFunc) libxml2_callback,
-                          (xmlSchemaValidityWarningFunc) libxml2_callback, (void *) o);
   if (schema_ctx) {
+    xmlSchemaSetValidErrors(schema_ctx,
+                            (xmlSchemaValidityErrorFunc) libxml2_callback,
+                            (xmlSchemaValidityWarningFunc) libxml2_callback, (void *) o);
     ret = xmlSchemaValidateDoc(schema_ctx, doc); /* validation */
     xmlSchemaFreeValidCtxt(schema_ctx);
   }
-  xmlFreeDoc(doc);
 
-  if (schema_generate) {
-    if (schema_type == WFS_SCHEMA_TYPE_100) o->schema_wfs_100 = schema;
-    else if (schema_type == WFS_SCHEMA_TYPE_110) o->schema_wfs_110 = schema;
+  return ret;
+}
+
+
+/*
+ * Return the compiled WFS schema matching a version
+ * Schema is compiled once, then kept for next requests
+ */
+xmlSchemaPtr ows_schema_wfs(ows * o, ows_version * version)
+{
+  xmlSchemaPtr *schema;
+  buffer *xml_schema;
+
+  assert(o);
+  assert(version);
+
+  if (ows_version_get(version) == 100) schema = &o->schema_wfs_100;
+  else                                 schema = &o->schema_wfs_110;
+
+  if (!*schema) {
+    xml_schema = wfs_generate_schema(o, version);
+    *schema = ows_generate_schema(o, xml_schema, false);
+    buffer_free(xml_schema);
   }
 
-  return ret;
+  return *schema;
+}
+
+
+/*
+ * Compile WFS schemas of all versions at once
+ * Called before any request, so that none of them pays for it
+ */
+void ows_schema_compile(ows * o)
+{
+  ows_version *version;
+  double start;
+
+  assert(o);
+
+  version = ows_version_init();
+  start = ows_time();
+
+  ows_version_set(version, 1, 0, 0);
+  if (!ows_schema_wfs(o, version)) ows_log(o, 1, "Unable to compile WFS 1.0.0 schema");
+
+  ows_version_set(version, 1, 1, 0);
+  if (!ows_schema_wfs(o, version)) ows_log(o, 1, "Unable to compile WFS 1.1.0 schema");
+
+  o->schema_time = ows_time() - start;
+  ows_version_free(version);
 }
 
 
@@ -263,10 +290,11 @@ static ows_version *ows_request_check_version(ows * o, ows_request * or, const a
 void ows_request_check(ows * o, ows_request * or, const array * cgi, const char *query)
 {
   list_node *srid;
-  buffer *typename, *xmlstring, *schema, *b=NULL;
+  buffer *typename, *b=NULL;
   ows_layer_node *ln = NULL;
   bool srsname = false;
   int valid = 0;
+  double start;
 
   assert(o && or && cgi && query);
 
@@ -389,19 +417,12 @@ void ows_request_check(ows * o, ows_request * or, const array * cgi, const char
                                || !strcmp(getenv("CONTENT_TYPE"), "text/plain")))
        || (!cgi_method_post() && !cgi_method_get() && query[0] == '<') /* Unit test command line use case */ ) {
 
-    if (or->service == WFS && o->check_schema) {
-      xmlstring = buffer_from_str(query);
-
-      if (ows_version_get(or->version) == 100) {
-        schema = wfs_generate_schema(o, or->version);
-        valid = ows_schema_validation(o, schema, xmlstring, false, WFS_SCHEMA_TYPE_100);
-      } else {
-        schema = wfs_generate_schema(o, or->version);
-        valid = ows_schema_validation(o, schema, xmlstring, false, WFS_SCHEMA_TYPE_110);
-      }
-
-      buffer_free(schema);
-      buffer_free(xmlstring);
+    /* The document parsed by cgi_parse_xml is validated once for all
+       (Transaction has no document, it is validated while streamed) */
+    if (or->service == WFS && o->check_schema && or->doc) {
+      start = ows_time();
+      valid = ows_schema_validation(o, ows_schema_wfs(o, or->version), or->doc);
+      ows_timing_add(o, OWS_TIMING_SCHEMA, start);
 
       if (valid != 0) {
         ows_error(o, OWS_ERROR_INVALID_PARAMETER_VALUE, "XML request isn't valid", "request");
@@ -46,6 +46,7 @@ ows_layer_storage * ows_layer_storage_init()
   storage->pkey_default = NULL;
   storage->pkey_column_number = -1;
   storage->attributes = array_init();
+  storage->attributes_type = hash_init(true);
   storage->not_null_columns = NULL;
 
   return storage;
@@ -63,6 +64,7 @@ void ows_layer_storage_free(ows_layer_storage * storage)
   if (storage->pkey_default)     buffer_free(storage->pkey_default);
   if (storage->geom_columns)     list_free(storage->geom_columns);
   if (storage->attributes)       array_free(storage->attributes);
+  if (storage->attributes_type)  hash_free(storage->attributes_type);
   if (storage->not_null_columns) list_free(storage->not_null_columns);
 
   free(storage);
@@ -397,6 +399,9 @@ static void ows_storage_fill_attributes(ows * o, ows_layer * l)
     }
 
     array_add(l->storage->attributes, b, t);
+
+    /* Resolve once how values of this attribute are written */
+    hash_add(l->storage->attributes_type, b, (void *) ows_psql_type_info_from_name(t));
   }
   PQclear(res);
 
@@ -470,6 +475,12 @@ static void ows_layer_storage_fill(ows * o, ows_layer * l, bool is_geom)
   ows_storage_fill_pkey(o, l);
   ows_storage_fill_attributes(o, l);
   ows_storage_fill_not_null(o, l);
+
+  /* Lists looked up for each column when rendering features */
+  list_index(l->storage->geom_columns);
+  if (l->storage->not_null_columns) list_index(l->storage->not_null_columns);
+  if (l->exclude_items)             list_index(l->exclude_items);
+  if (l->gml_ns)                    list_index(l->gml_ns);
 }
 
 
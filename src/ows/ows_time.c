@@ -0,0 +1,162 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "ows.h"
+
+
+/* Names of the request phases, as in Server-Timing header */
+static const char *ows_timing_names[OWS_TIMING_PHASES] = {
+  "parse", "schema", "filter", "sql", "render", "write"
+};
+
+
+/*
+ * Return a monotonic wall clock time, in seconds
+ * Only differences between two calls are meaningful
+ */
+double ows_time()
+{
+#ifndef _WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+#else
+  /* Wall clock with MSVC */
+  return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+
+/*
+ * Reset request timing, at its very beginning
+ */
+void ows_timing_start(ows * o)
+{
+  assert(o);
+
+  memset(&(o->timing), 0, sizeof(ows_timing));
+  o->timing.start = ows_time();
+}
+
+
+/*
+ * Account the time elapsed since start to a request phase
+ */
+void ows_timing_add(ows * o, enum ows_timing_phase phase, double start)
+{
+  assert(o);
+
+  o->timing.phase[phase] += ows_time() - start;
+}
+
+
+/*
+ * Write the Server-Timing header, if asked in config
+ * Headers are sent before the response body, so only phases done
+ * so far could be there: the full picture is in the log
+ */
+void ows_timing_header(ows * o)
+{
+  int i;
+
+  assert(o);
+
+  if (!o->server_timing || o->timing.header) return;
+  o->timing.header = true;
+
+  fprintf(o->output, "Server-Timing: ");
+  for (i = 0 ; i < OWS_TIMING_PHASES ; i++)
+    if (o->timing.phase[i] > 0.0)
+      fprintf(o->output, "%s;dur=%.3f, ", ows_timing_names[i], o->timing.phase[i] * 1000.0);
+  fprintf(o->output, "total;dur=%.3f\n", (ows_time() - o->timing.start) * 1000.0);
+}
+
+
+/*
+ * Log the request phases, rows and round trips (log level 16)
+ */
+void ows_timing_log(ows * o)
+{
+  buffer *b, *fields;
+  double total;
+  int i;
+
+  assert(o);
+
+  if (!ows_log_enabled(o, 16)) return;
+
+  total = (ows_time() - o->timing.start) * 1000.0;
+
+  /* Text message, and the same as JSON fields */
+  b = buffer_init();
+  fields = buffer_init();
+  buffer_add_str(fields, "\"total_ms\":");
+  buffer_add_double_fixed(fields, total, 3);
+
+  buffer_add_str(b, "total=");
+  buffer_add_double_fixed(b, total, 3);
+  buffer_add_str(b, "ms");
+
+  for (i = 0 ; i < OWS_TIMING_PHASES ; i++) {
+    buffer_add(b, ' ');
+    buffer_add_str(b, ows_timing_names[i]);
+    buffer_add(b, '=');
+    buffer_add_double_fixed(b, o->timing.phase[i] * 1000.0, 3);
+    buffer_add_str(b, "ms");
+
+    buffer_add_str(fields, ",\"");
+    buffer_add_str(fields, ows_timing_names[i]);
+    buffer_add_str(fields, "_ms\":");
+    buffer_add_double_fixed(fields, o->timing.phase[i] * 1000.0, 3);
+  }
+
+  buffer_add_str(b, " queries=");
+  buffer_add_long(b, (long) o->timing.sql);
+  buffer_add_str(b, " rows=");
+  buffer_add_long(b, (long) o->timing.rows);
+
+  buffer_add_str(fields, ",\"queries\":");
+  buffer_add_long(fields, (long) o->timing.sql);
+  buffer_add_str(fields, ",\"rows\":");
+  buffer_add_long(fields, (long) o->timing.rows);
+
+  ows_log_fields(o, 16, b->buf, fields->buf);
+  buffer_free(fields);
+  buffer_free(b);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -29,7 +29,21 @@ buffer *array_get_key(const array * a, const char *value);
 array *array_init ();
 bool array_is_key (const array * a, const char *key);
 bool array_is_value (const array * a, const char *value);
+hash *hash_init(bool nocase);
+hash *hash_init_like(const void *owner, bool nocase);
+void hash_free(hash * h);
+void hash_add(hash * h, buffer * key, void *value);
+void *hash_get(const hash * h, const char *key);
+void hash_remove(hash * h, const buffer * key);
 alist *alist_init();
+arena *arena_init();
+void arena_free(arena * a);
+void arena_reset(arena * a);
+arena *arena_use(arena * a);
+void *arena_malloc(size_t size);
+void *arena_malloc_like(const void *owner, size_t size);
+void *arena_realloc(void *p, size_t size);
+void arena_release(void *p);
 void alist_free(alist * al);
 void alist_add(alist * al, buffer * key, buffer * value);
 bool alist_is_key(const alist * al, const char *key);
@@ -37,10 +51,17 @@ list *alist_get(const alist * al, const char *key);
 void alist_flush(const alist * al, FILE * output);
 void buffer_add (buffer * buf, char c);
 void buffer_add_double (buffer * buf, double f);
+void buffer_add_double_fixed (buffer * buf, double f, int precision);
+size_t buffer_dtoa (char *s, double f, int precision);
 void buffer_add_head (buffer * buf, char c);
 void buffer_add_head_str (buffer * buf, char *str);
 void buffer_add_int (buffer * buf, int i);
+void buffer_add_long (buffer * buf, long int l);
 void buffer_add_str (buffer * buf, const char *str);
+void buffer_add_xml_entities (buffer * buf, const char * str);
+void buffer_add_json_str (buffer * buf, const char * str);
+size_t buffer_clean_span (const char * str, const char * special);
+void buffer_fputs_xml_entities (const char * str, FILE * output);
 void buffer_add_nstr (buffer * buf, const char *str, size_t n);
 buffer *buffer_from_str(const char *str);
 bool buffer_cmp (const buffer * buf, const char *str);
@@ -51,6 +72,7 @@ buffer *buffer_clone(buffer * buf);
 void buffer_empty (buffer * buf);
 void buffer_flush (buffer * buf, FILE * output);
 void buffer_free (buffer * buf);
+void buffer_reserve (buffer * buf, size_t n);
 buffer *buffer_ftoa (double f);
 buffer *buffer_init ();
 buffer *buffer_itoa (int i);
@@ -62,18 +84,29 @@ long int buffer_rchr(const buffer * buf, char c);
 buffer *buffer_encode_xml_entities_str(const char *str);
 buffer *buffer_encode_json_str(const char *str);
 buffer *cgi_add_xml_into_buffer (buffer * element, xmlNodePtr n);
+void cgi_body_free (ows * o, char *body);
+char *cgi_body_read (ows * o, size_t size);
 char *cgi_getback_query (ows * o);
 bool cgi_method_get ();
 bool cgi_method_post ();
 array *cgi_parse_kvp (ows * o, char *query);
 array *cgi_parse_xml (ows * o, char *query);
 bool check_regexp (const char *str_request, const char *str_regex);
+void fe_cache_add (ows * o, buffer * key, buffer * sql, const list * slots, const list * values);
+void fe_cache_free (fe_cache * c);
+buffer *fe_cache_get (ows * o, const buffer * key);
+fe_cache *fe_cache_init (size_t size);
+bool fe_cache_key (ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr filter, buffer * key, list * values);
+void fe_cache_render (buffer * sql, const buffer * template, const list * slots);
 buffer *fe_comparison_op (ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n);
 buffer *fe_envelope (ows * o, buffer * typename, filter_encoding * fe, buffer *envelope, xmlNodePtr n);
 void fe_error (ows * o, filter_encoding * fe);
 buffer *fe_expression (ows * o, buffer * typename, filter_encoding * fe, buffer * sql, xmlNodePtr n);
 buffer *fe_feature_id (ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n);
+list *fe_feature_id_list (ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n);
+void fe_featureid_sql (ows * o, buffer * sql, const buffer * id_name, const list * ids);
 filter_encoding *fe_filter (ows * o, filter_encoding * fe, buffer * typename, buffer * xmlchar);
+filter_encoding *fe_filter_node (ows * o, filter_encoding * fe, buffer * typename, xmlNodePtr filter);
 void fe_filter_capabilities_100 (const ows * o);
 void fe_filter_capabilities_110 (const ows * o);
 buffer *fe_function (ows * o, buffer * typename, filter_encoding * fe, buffer * sql, xmlNodePtr n);
@@ -84,6 +117,7 @@ buffer *fe_kvp_bbox (ows * o, wfs_request * wr, buffer * layer_name, ows_bbox *
 buffer *fe_kvp_featureid (ows * o, wfs_request * wr, buffer * layer_name, list * fid);
 buffer *fe_logical_op (ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n);
 void fe_node_flush (xmlNodePtr node, FILE * output);
+void fe_optimize (xmlNodePtr filter);
 buffer *fe_property_name (ows * o, buffer * typename, filter_encoding * fe, buffer * sql, xmlNodePtr n, bool check_geom_column, bool mandatory);
 buffer *fe_spatial_op (ows * o, buffer * typename, filter_encoding * fe, xmlNodePtr n);
 buffer *fe_xpath_property_name (ows * o, buffer * typename, buffer * property);
@@ -95,6 +129,7 @@ bool in_list (const list * l, const buffer * value);
 bool in_list_str (const list * l, const char * value);
 void list_add (list * l, buffer * value);
 void list_add_by_copy (list * l, buffer * value);
+void list_index (list * l);
 void list_add_list (list * l, list * l_to_add);
 void list_add_str (list * l, char *value);
 void list_pop(list *l);
@@ -130,8 +165,12 @@ void ows_contact_flush (ows_contact * contact, FILE * output);
 void ows_contact_free (ows_contact * contact);
 ows_contact *ows_contact_init ();
 void ows_error (ows * o, enum ows_error_code code, char *message, char *locator);
+char *ows_error_code_string (enum ows_error_code code);
 void ows_flush (ows * o, FILE * output);
 void ows_free (ows * o);
+ows *ows_init ();
+void ows_kvp_or_xml (ows * o, char *query);
+void ows_pg (ows * o, char *con_str);
 ows_geobbox *ows_geobbox_compute (ows * o, buffer * layer_name);
 void ows_geobbox_flush (const ows_geobbox * g, FILE * output);
 void ows_geobbox_free (ows_geobbox * g);
@@ -140,6 +179,7 @@ ows_geobbox *ows_geobbox_copy(ows_geobbox *g);
 bool ows_geobbox_set (ows * o, ows_geobbox * g, double west, double east, double south, double north);
 bool ows_geobbox_set_from_bbox (ows * o, ows_geobbox * g, ows_bbox * bb);
 ows_geobbox *ows_geobbox_set_from_str (ows * o, ows_geobbox * g, char *str);
+buffer *ows_gml_to_ewkb (ows * o, xmlNodePtr n, int srid);
 void ows_get_capabilities_dcpt (const ows * o, const char * req);
 void ows_layer_flush (ows_layer * l, FILE * output);
 void ows_layer_free (ows_layer * l);
@@ -176,12 +216,17 @@ ows_meta *ows_metadata_init ();
 void ows_parse_config (ows * o, const char *filename);
 ows_version * ows_psql_postgis_version(ows *o);
 PGresult * ows_psql_exec(ows *o, const char *sql);
+PGresult *ows_psql_copy(ows * o, const char *sql, const buffer * data);
+int ows_psql_pipeline_begin(ows * o, const list * sql);
+PGresult *ows_psql_pipeline_result(ows * o);
+void ows_psql_pipeline_end(ows * o);
 buffer *ows_psql_column_name (ows * o, buffer * layer_name, int number);
 array *ows_psql_describe_table (ows * o, buffer * layer_name);
 list *ows_psql_geometry_column (ows * o, buffer * layer_name);
 buffer *ows_psql_schema_name(ows * o, buffer * layer_name);
 buffer *ows_psql_table_name(ows * o, buffer * layer_name);
 buffer *ows_psql_id_column (ows * o, buffer * layer_name);
+buffer *ows_psql_id_default(ows * o, buffer * layer_name);
 buffer *ows_psql_column_constraint_name(ows * o, buffer * column_name, buffer * table_name);
 list *ows_psql_column_check_constraint(ows * o, buffer * constraint_name);
 buffer *ows_psql_column_character_maximum_length(ows * o, buffer * column_name, buffer * table_name);
@@ -193,6 +238,8 @@ buffer *ows_psql_timestamp_to_xml_time (char *timestamp);
 char *ows_psql_to_xsd (buffer * type, enum wfs_format format);
 bool ows_psql_is_numeric(buffer * type);
 buffer *ows_psql_type (ows * o, buffer * layer_name, buffer * property);
+const ows_psql_type_info *ows_psql_type_info_from_name(const buffer * type);
+const ows_psql_type_info *ows_psql_type_info_get(ows * o, buffer * layer_name, const char * property);
 buffer *ows_psql_generate_id (ows * o, buffer * layer_name);
 int ows_psql_number_features(ows * o, list * from, list * where);
 buffer * ows_psql_gml_to_sql(ows * o, xmlNodePtr n, int srid);
@@ -202,7 +249,9 @@ void ows_request_check (ows * o, ows_request * or, const array * cgi, const char
 void ows_request_flush (ows_request * or, FILE * output);
 void ows_request_free (ows_request * or);
 ows_request *ows_request_init ();
-int ows_schema_validation (ows * o, buffer * xml_schema, buffer * xml, bool schema_is_file, enum ows_schema_type schema_type);
+int ows_schema_validation (ows * o, xmlSchemaPtr schema, xmlDocPtr doc);
+xmlSchemaPtr ows_schema_wfs (ows * o, ows_version * version);
+void ows_schema_compile (ows * o);
 void ows_service_identification (const ows * o);
 void ows_service_metadata (const ows * o);
 void ows_service_provider (const ows * o);
@@ -218,7 +267,18 @@ bool ows_srs_set_geobbox(ows * o, ows_srs * s);
 bool ows_srs_set (ows * o, ows_srs * c, const buffer * auth_name, int auth_srid);
 bool ows_srs_set_from_srid (ows * o, ows_srs * s, int srid);
 bool ows_srs_set_from_srsname(ows * o, ows_srs * s, const char *srsname);
+void ows_metrics_report (ows * o);
+void ows_metrics_free (ows_metrics * m);
+ows_metrics *ows_metrics_init ();
+bool ows_metrics_is_request (ows * o, const array * cgi);
+void ows_metrics_record (ows * o);
+void ows_metrics_select (ows * o);
 void ows_usage (ows * o);
+double ows_time ();
+void ows_timing_add (ows * o, enum ows_timing_phase phase, double start);
+void ows_timing_header (ows * o);
+void ows_timing_log (ows * o);
+void ows_timing_start (ows * o);
 void ows_version_flush (ows_version * v, FILE * output);
 void ows_version_free (ows_version * v);
 bool ows_version_check(ows_version *v);
@@ -231,10 +291,12 @@ void wfs_delete (ows * o, wfs_request * wr);
 void wfs_describe_feature_type (ows * o, wfs_request * wr);
 buffer * wfs_generate_schema(ows * o, ows_version * version);
 void wfs_error (ows * o, wfs_request * wf, enum wfs_error_code code, char *message, char *locator);
+char *wfs_error_code_string (enum wfs_error_code code);
 void wfs_get_capabilities (ows * o, wfs_request * wr);
 void wfs_get_feature (ows * o, wfs_request * wr);
+void wfs_geojson_feature_member (ows * o, buffer * layer_name, PGresult * res);
 void wfs_gml_feature_member (ows * o, wfs_request * wr, buffer * layer_name, list * properties, PGresult * res);
-void wfs_parse_operation (ows * o, wfs_request * wr, buffer * op);
+void wfs_parse_operation (ows * o, wfs_request * wr, const char * query);
 void wfs_request_check (ows * o, wfs_request * wr, const array * cgi);
 void wfs_request_flush (wfs_request * wr, FILE * output);
 buffer *wfs_request_remove_prop_ns_prefix(ows * o, buffer * prop, list * layer_name);
@@ -247,5 +309,13 @@ void ows_layers_storage_fill(ows * o);
 ows_layer * ows_layer_get(const ows_layer_list * ll, const buffer * name);
 void ows_layers_storage_flush(ows * o, FILE * output);
 void ows_log(ows *o, int log_level, const char *log);
+bool ows_log_enabled (const ows * o, int log_level);
+void ows_log_fields (ows * o, int log_level, const char *log, const char *fields);
+void ows_log_flush (ows * o);
+void ows_log_request (ows * o);
+void ows_log_sampling (ows * o, const char *sampling);
+void ows_logger_free (ows_logger * l);
+ows_logger *ows_logger_init ();
 void ows_parse_config_mapfile(ows *o, const char *filename);
 bool ows_libxml_check_namespace(ows *o, xmlNodePtr n);
+bool ows_libxml_check_namespace_element(ows *o, xmlNodePtr n);
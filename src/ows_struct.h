@@ -36,16 +36,56 @@ enum Bool {
 
 typedef enum Bool bool;
 
-#define BUFFER_SIZE_INIT   256
+#define ARENA_BLOCK_SIZE   65536  /* memory carved at once by an arena */
+#define ARENA_CHUNK_MIN    16     /* smallest arena size class */
+#define ARENA_CHUNK_MAX    4096   /* biggest one, larger chunks come from heap */
+#define ARENA_CLASSES      9
+
+typedef struct Arena_block {
+  struct Arena_block * next;
+  size_t size;
+  size_t use;
+  double data[1];             /** memory carved, double to keep it aligned */
+} arena_block;
+
+typedef struct Arena {
+  arena_block * first;
+  arena_block * current;
+  size_t generation;          /** incremented on each reset */
+  void * free[ARENA_CLASSES]; /** released chunks, by size class */
+  size_t allocated;           /** bytes asked since init, for statistics */
+} arena;
+
+#define BUFFER_SIZE_INLINE 40   /* short strings are stored inside the struct itself */
+#define BUFFER_SIZE_MIN    64   /* first allocation once inline storage is too short */
+#define BUFFER_SPECIAL_MAX 8    /* special chars looked for by buffer_clean_span() */
+#define BUFFER_DOUBLE_SIZE 400  /* enough for buffer_dtoa() of any double */
 
 typedef struct Buffer {
   size_t use;     /** size used for data */
   size_t size;    /** memory available */
-  size_t realloc;   /** size to next realloc */
-  char * buf;     /** data */
+  char * buf;     /** data, either local or allocated */
+  char local[BUFFER_SIZE_INLINE];
 } buffer;
 
 
+#define HASH_SIZE_INIT     16
+#define HASH_MIN_ENTRIES   8    /* containers are indexed once they reach this size */
+
+typedef struct Hash_slot {
+  buffer * key;
+  void * value;
+  size_t hash;
+} hash_slot;
+
+typedef struct Hash {
+  size_t size;    /** slots available, power of two */
+  size_t count;   /** slots used */
+  bool nocase;    /** case insensitive keys */
+  hash_slot * slots;
+} hash;
+
+
 typedef struct List_node {
   buffer * value;
   struct List_node * next;
@@ -56,6 +96,7 @@ typedef struct List {
   list_node * first;
   list_node * last;
   unsigned int size;
+  hash * index;   /** values set, only for lists indexed by list_index() */
 } list;
 
 
@@ -81,6 +122,8 @@ typedef struct Alist_node {
 typedef struct Alist {
   alist_node * first;
   alist_node * last;
+  unsigned int size;
+  hash * index;   /** keys index, once size is large enough */
 } alist;
 
 
@@ -93,11 +136,26 @@ typedef struct Array_node {
 typedef struct Array {
   array_node * first;
   array_node * last;
+  unsigned int size;
+  hash * index;   /** keys index, once size is large enough */
 } array;
 
 
 /* ========= OWS Common ========= */
 
+enum ows_psql_type {
+  OWS_PSQL_TYPE_OTHER,
+  OWS_PSQL_TYPE_TEXT,
+  OWS_PSQL_TYPE_NUMERIC,
+  OWS_PSQL_TYPE_BOOL,
+  OWS_PSQL_TYPE_TIMESTAMP
+};
+
+typedef struct Ows_psql_type_info {
+  enum ows_psql_type type;
+  void (*encode) (FILE * output, const char * value);  /** write a value as GML content */
+} ows_psql_type_info;
+
 typedef struct Ows_layer_storage {
   buffer * schema;
   buffer * table;
@@ -110,6 +168,7 @@ typedef struct Ows_layer_storage {
   int pkey_column_number;
   bool is_degree;
   array * attributes;
+  hash * attributes_type;   /** attribute name to its ows_psql_type_info */
 } ows_layer_storage;
 
 typedef struct Ows_srs {
@@ -159,7 +218,8 @@ enum ows_error_code {
   OWS_ERROR_REQUEST_HTTP,
   OWS_ERROR_FORBIDDEN_CHARACTER,
   OWS_ERROR_MISSING_METADATA,
-  OWS_ERROR_NO_SRS_DEFINED
+  OWS_ERROR_NO_SRS_DEFINED,
+  OWS_ERROR_REQUEST_TOO_LARGE
 };
 
 
@@ -284,10 +344,14 @@ enum wfs_insert_idgen {
   WFS_REPLACE_DUPLICATE
 };
 
-enum ows_schema_type {
-  WFS_SCHEMA_TYPE_100,
-  WFS_SCHEMA_TYPE_110
-};
+typedef struct Wfs_column {
+  char * name;
+  const ows_psql_type_info * type;
+  bool display;   /** column is part of the output */
+  bool gml_ns;    /** property belongs to gml namespace */
+} wfs_column;
+
+#define WFS_TRANSACTION_QUEUE_MAX 1000  /* requests sent at once in a pipeline */
 
 typedef struct Wfs_request {
   enum wfs_request request;
@@ -299,6 +363,7 @@ typedef struct Wfs_request {
   ows_srs * srs;
   mlist * featureid;
   list * filter;
+  xmlNodePtr * filter_node;         /** Filter elements of an XML request, by Query */
   buffer * operation;
   list * handle;
   buffer * resulttype;
@@ -310,6 +375,19 @@ typedef struct Wfs_request {
   int delete_results;
   int update_results;
 
+  list * transaction_sql;           /** requests queued, not yet sent */
+  list * transaction_locator;       /** handle matching each queued request */
+
+  buffer * transaction_set_layer;   /** layer of the grouped Update/Delete */
+  buffer * transaction_set_sql;     /** grouped statement head */
+  buffer * transaction_set_values;  /** grouped Update VALUES rows */
+  buffer * transaction_set_end;     /** grouped Update statement tail */
+  list * transaction_set_ids;       /** feature ids already grouped */
+  buffer * transaction_set_locator; /** handle of the first grouped operation */
+
+  xmlTextReaderPtr transaction_reader; /** streamed Transaction request */
+  bool transaction_invalid;            /** request found invalid while streamed */
+
 } wfs_request;
 
 
@@ -332,19 +410,100 @@ enum fe_error_code {
 };
 
 typedef struct Filter_encoding {
-  bool in_not;
   bool is_numeric;
   buffer * sql;
+  list * slots;     /** envelopes, while compiling a template for the cache */
   enum fe_error_code error_code;
 } filter_encoding;
 
+#define OWS_FILTER_CACHE_SIZE  256
+#define FE_CACHE_SLOT          '\001'  /* slot delimiter in a SQL template */
+
+typedef struct Fe_cache_entry {
+  buffer * key;
+  buffer * sql;     /** SQL template */
+  struct Fe_cache_entry * prev;
+  struct Fe_cache_entry * next;
+} fe_cache_entry;
+
+typedef struct Fe_cache {
+  hash * index;
+  fe_cache_entry * first;   /** most recently used */
+  fe_cache_entry * last;
+  size_t count;
+  size_t size;              /** max entries */
+  unsigned long hits;
+  unsigned long misses;
+} fe_cache;
+
 
 /* ========= OWS Request & Main ========= */
 
+/* Request phases, in Server-Timing header order */
+enum ows_timing_phase {
+  OWS_TIMING_PARSE,
+  OWS_TIMING_SCHEMA,
+  OWS_TIMING_FILTER,
+  OWS_TIMING_SQL,
+  OWS_TIMING_RENDER,
+  OWS_TIMING_WRITE,
+  OWS_TIMING_PHASES
+};
+
+#define OWS_METRICS_BUCKETS 11   /* request duration buckets, but +Inf */
+
+typedef struct Ows_metrics_entry {
+  buffer * labels;                          /** operation, format and layer labels */
+  unsigned long requests;
+  unsigned long buckets[OWS_METRICS_BUCKETS];  /** requests by duration bucket, not cumulated */
+  double seconds;
+  unsigned long sql;
+  double sql_seconds;
+  unsigned long rows;
+  struct Ows_metrics_entry * next;
+} ows_metrics_entry;
+
+typedef struct Ows_metrics {
+  double start;                             /** process start, from ows_time() */
+  long pid;
+  hash * index;                             /** entries by labels */
+  ows_metrics_entry * first;
+  ows_metrics_entry * last;
+  ows_metrics_entry * current;              /** entry of the request being served */
+  unsigned long ows_errors[OWS_ERROR_REQUEST_TOO_LARGE + 1];
+  unsigned long wfs_errors[WFS_ERROR_MISSING_PARAMETER + 1];
+} ows_metrics;
+
+typedef struct Ows_timing {
+  double start;                       /** request start, from ows_time() */
+  double phase[OWS_TIMING_PHASES];    /** seconds spent in each phase */
+  unsigned long sql;                  /** database round trips */
+  unsigned long rows;                 /** features rendered */
+  bool header;                        /** Server-Timing header already sent */
+} ows_timing;
+
+#define OWS_LOG_LEVELS      5            /* ERROR EVENT QUERY SQL TIMING */
+#define OWS_LOG_BUFFER_SIZE (64 * 1024)  /* pending log lines are written above */
+
+typedef struct Ows_logger {
+  FILE * file;                    /** opened on first write */
+  buffer * lines;                 /** lines not written yet */
+  bool json;                      /** JSON lines rather than text ones */
+  bool defer;                     /** within a request, lines wait its end */
+  long pid;
+  unsigned long request;          /** request number, since process start */
+  int sampling[OWS_LOG_LEVELS];   /** log 1 request in n, by level */
+  int sampled;                    /** levels logged by the current request */
+  long second;                    /** second of the cached stamp */
+  char stamp[32];
+} ows_logger;
+
 typedef struct Ows_request {
   ows_version * version;
   enum ows_method method;
   enum ows_service service;
+  const char * body;        /** XML request, streamed by Transaction */
+  xmlDocPtr doc;            /** XML request, parsed once (but Transaction) */
   union {
     wfs_request * wfs;
   } request;
@@ -353,7 +512,10 @@ typedef struct Ows_request {
 #define OWS_DEFAULT_XML_ENCODING "UTF-8"
 #define OWS_DEFAULT_DB_ENCODING "UTF8"
 
-#define OWS_MAX_DOUBLE 1e15  /* %f vs %g */
+#define OWS_MAX_DOUBLE 1e15  /* fixed precision vs shortest output */
+
+#define OWS_REQUEST_MAX_SIZE   (1024 * 1024 * 1024)  /* default POST body limit */
+#define OWS_REQUEST_SPOOL_SIZE (8 * 1024 * 1024)     /* default in memory POST body */
 
 typedef struct Ows {
   bool init;
@@ -367,7 +529,7 @@ typedef struct Ows {
   buffer * encoding;
   buffer * db_encoding;
 
-  FILE* log;
+  ows_logger * log;
   int log_level;
   buffer * log_file;
 
@@ -388,6 +550,12 @@ typedef struct Ows {
 
   bool check_schema;
   bool check_valid_geom;
+  bool server_timing;
+
+  size_t request_max_size;     /** POST body size limit, 0 for none */
+  size_t request_spool_size;   /** POST body above is spooled to disk */
+  size_t query_mapped;         /** mapped size of a spooled POST body */
+  size_t filter_cache_size;    /** compiled filters kept, 0 for none */
 
   array * cgi;
   list * psql_requests;
@@ -398,6 +566,19 @@ typedef struct Ows {
 
   xmlSchemaPtr  schema_wfs_100;
   xmlSchemaPtr  schema_wfs_110;
+  double schema_time;     /** schemas compilation time, in seconds */
+
+  arena * arena;          /** per request memory */
+  ows_timing timing;      /** current request phases */
+  ows_metrics * metrics;  /** counters since process start */
+  buffer * metrics_token; /** token asked by Metrics request, NULL if disabled */
+  fe_cache * filter_cache;
+
+  buffer * gml_srsname;   /** last srsName decoded from GML */
+  ows_srs * gml_srs;
+#if TINYOWS_GEOS
+  GEOSContextHandle_t geos;
+#endif
 } ows;
 
 #endif /* OWS_STRUCT_H */
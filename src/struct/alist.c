@@ -40,11 +40,13 @@ alist *alist_init()
 {
   alist *al = NULL;
 
-  al = malloc(sizeof(alist));
+  al = arena_malloc(sizeof(alist));
   assert(al);
 
   al->first = NULL;
   al->last = NULL;
+  al->size = 0;
+  al->index = NULL;
 
   return al;
 }
@@ -66,15 +68,35 @@ void alist_free(alist * al)
 
     buffer_free(an_to_free->key);
     list_free(an_to_free->value);
-    free(an_to_free);
+    arena_release(an_to_free);
     an_to_free = NULL;
   }
 
-  free(al);
+  if (al->index) hash_free(al->index);
+  arena_release(al);
   al = NULL;
 }
 
 
+/*
+ * Return the node matching a key, or NULL if none
+ */
+static alist_node *alist_node_get(const alist * al, const char *key)
+{
+  alist_node *an;
+  size_t ks;
+
+  if (al->index) return hash_get(al->index, key);
+
+  for (ks = strlen(key), an = al->first ; an ; an = an->next)
+    if (ks == an->key->use)
+      if (buffer_case_cmp(an->key, key))
+        return an;
+
+  return NULL;
+}
+
+
 /*
  * Add a given buffer to the end of an alist entry
  * if key exist, value is add to the list
@@ -88,8 +110,10 @@ void alist_add(alist * al, buffer * key, buffer * value)
   assert(key);
   assert(value);
 
-  if (!alist_is_key(al, key->buf)) {
-    an = malloc(sizeof(alist_node));
+  an = alist_node_get(al, key->buf);
+
+  if (!an) {
+    an = arena_malloc(sizeof(alist_node));
     assert(an);
 
     an->key = key;
@@ -100,10 +124,14 @@ void alist_add(alist * al, buffer * key, buffer * value)
 
     al->last = an;
     al->last->next = NULL;
-  } else {
-    for (an = al->first ; an ; an = an->next)
-      if (buffer_case_cmp(an->key, key->buf))
-        break;
+    al->size++;
+
+    if (al->index) hash_add(al->index, key, an);
+    else if (al->size == HASH_MIN_ENTRIES) {
+      al->index = hash_init_like(al, true);
+      for (an = al->first ; an ; an = an->next) hash_add(al->index, an->key, an);
+      an = al->last;
+    }
   }
 
   list_add(an->value, value);
@@ -115,18 +143,10 @@ void alist_add(alist * al, buffer * key, buffer * value)
  */
 bool alist_is_key(const alist * al, const char *key)
 {
-  alist_node *an;
-  size_t ks;
-
   assert(al);
   assert(key);
 
-  for (ks = strlen(key), an = al->first ; an ; an = an->next)
-    if (ks == an->key->use)
-      if (buffer_case_cmp(an->key, key))
-        return true;
-
-  return false;
+  return alist_node_get(al, key) ? true : false;
 }
 
 
@@ -138,17 +158,11 @@ bool alist_is_key(const alist * al, const char *key)
 list *alist_get(const alist * al, const char *key)
 {
   alist_node *an;
-  size_t ks;
 
   assert(al);
   assert(key);
 
-  for (ks = strlen(key), an = al->first ; an ; an = an->next) {
-    if (ks == an->key->use)
-      if (buffer_case_cmp(an->key, key))
-        break;
-  }
-
+  an = alist_node_get(al, key);
   assert(an);
 
   return an->value;
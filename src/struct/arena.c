@@ -0,0 +1,305 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/*
+ * Per request memory arena
+ *
+ * buffer, list, mlist, alist and array allocate their memory through
+ * arena_malloc(). While an arena is in use (i.e while a request is
+ * processed) small chunks are carved from large blocks, and released
+ * chunks are kept in free lists by size class to be reused. Whole arena
+ * is then reset in one go once the request is done.
+ * Out of a request (config, storage...) memory comes from the heap.
+ *
+ * Each chunk is preceded by a header:
+ *   bit 0       arena chunk (1) or heap chunk (0)
+ *   bits 1-4    size class, for arena chunk
+ *   bits 8-     arena generation (arena chunk), or size (heap chunk)
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../ows/ows.h"
+
+
+#define ARENA_HEADER       sizeof(arena_header)
+#define ARENA_CHUNK(p)     ((arena_header *) (p) - 1)
+#define ARENA_CLASS_SIZE(c) ((size_t) ARENA_CHUNK_MIN << (c))
+
+typedef union Arena_header {
+  size_t info;
+  double align;
+} arena_header;
+
+
+/* Arena currently used to allocate, NULL means heap */
+static arena *arena_current = NULL;
+
+
+/*
+ * Initialize an arena structure
+ */
+arena *arena_init()
+{
+  arena *a;
+
+  a = malloc(sizeof(arena));
+  assert(a);
+
+  a->first = NULL;
+  a->current = NULL;
+  a->generation = 1;
+  memset(a->free, 0, sizeof(a->free));
+  a->allocated = 0;
+
+  return a;
+}
+
+
+/*
+ * Free an arena structure and all its blocks
+ */
+void arena_free(arena * a)
+{
+  arena_block *b, *next;
+
+  assert(a);
+
+  if (arena_current == a) arena_current = NULL;
+
+  for (b = a->first ; b ; b = next) {
+    next = b->next;
+    free(b);
+  }
+
+  free(a);
+  a = NULL;
+}
+
+
+/*
+ * Release all chunks allocated since last reset
+ * Blocks are kept to be used again by next request
+ */
+void arena_reset(arena * a)
+{
+  assert(a);
+
+  a->current = a->first;
+  if (a->current) a->current->use = 0;
+
+  memset(a->free, 0, sizeof(a->free));
+
+  /* Chunks from previous generation are now unknown */
+  a->generation++;
+}
+
+
+/*
+ * Set the arena used by next allocations (NULL for heap)
+ * Return the one previously used
+ */
+arena *arena_use(arena * a)
+{
+  arena *prev;
+
+  prev = arena_current;
+  arena_current = a;
+
+  return prev;
+}
+
+
+/*
+ * Carve a chunk from arena blocks
+ */
+static void *arena_carve(arena * a, size_t size)
+{
+  arena_block *b;
+  void *p;
+
+  /* Go to next block, allocating it if needed */
+  while (!a->current || a->current->use + size > a->current->size) {
+    if (a->current && a->current->next) {
+      a->current = a->current->next;
+      a->current->use = 0;
+      continue;
+    }
+
+    b = malloc(sizeof(arena_block) + ARENA_BLOCK_SIZE);
+    assert(b);
+
+    b->next = NULL;
+    b->size = ARENA_BLOCK_SIZE;
+    b->use = 0;
+
+    if (!a->first) a->first = b;
+    else           a->current->next = b;
+    a->current = b;
+  }
+
+  p = (char *) a->current->data + a->current->use;
+  a->current->use += size;
+
+  return p;
+}
+
+
+/*
+ * Allocate memory, from current arena if any and size is small enough
+ */
+void *arena_malloc(size_t size)
+{
+  arena_header *h;
+  arena *a;
+  int c;
+
+  a = arena_current;
+  if (a) a->allocated += size;
+
+  if (!a || size > ARENA_CHUNK_MAX) {
+    h = malloc(ARENA_HEADER + size);
+    assert(h);
+    h->info = size << 8;
+
+    return h + 1;
+  }
+
+  for (c = 0 ; ARENA_CLASS_SIZE(c) < size ; c++);
+
+  if (a->free[c]) {
+    h = ARENA_CHUNK(a->free[c]);
+    a->free[c] = *((void **) a->free[c]);
+  } else h = arena_carve(a, ARENA_HEADER + ARENA_CLASS_SIZE(c));
+
+  h->info = (a->generation << 8) | (c << 1) | 1;
+
+  return h + 1;
+}
+
+
+/*
+ * Allocate memory of the same kind (arena or heap) than an owner chunk
+ * So a long lived structure could get new memory during a request,
+ * without caller having to switch arena
+ */
+void *arena_malloc_like(const void *owner, size_t size)
+{
+  arena *prev;
+  void *p;
+
+  assert(owner);
+
+  if (ARENA_CHUNK(owner)->info & 1) return arena_malloc(size);
+
+  prev = arena_use(NULL);
+  p = arena_malloc(size);
+  arena_use(prev);
+
+  return p;
+}
+
+
+/*
+ * Usable size of a chunk
+ */
+static size_t arena_chunk_size(void *p)
+{
+  arena_header *h;
+
+  h = ARENA_CHUNK(p);
+  if (h->info & 1) return ARENA_CLASS_SIZE((h->info >> 1) & 0x0F);
+
+  return h->info >> 8;
+}
+
+
+/*
+ * Release a chunk
+ * Arena chunks are kept in a free list, to be reused by same size class
+ */
+void arena_release(void *p)
+{
+  arena_header *h;
+  arena *a;
+  int c;
+
+  if (!p) return;
+
+  h = ARENA_CHUNK(p);
+  if (!(h->info & 1)) {
+    free(h);
+    return;
+  }
+
+  /* Out of its request, chunk will anyway be freed with the arena */
+  a = arena_current;
+  if (!a || (h->info >> 8) != (a->generation & (SIZE_MAX >> 8))) return;
+
+  c = (h->info >> 1) & 0x0F;
+  *((void **) p) = a->free[c];
+  a->free[c] = p;
+}
+
+
+/*
+ * Resize a chunk, keeping its content
+ * A heap chunk stays in heap, so long lived structures could safely grow
+ * during a request
+ */
+void *arena_realloc(void *p, size_t size)
+{
+  arena_header *h;
+  void *q;
+  size_t old;
+
+  if (!p) return arena_malloc(size);
+
+  old = arena_chunk_size(p);
+  if (size <= old) return p;
+
+  h = ARENA_CHUNK(p);
+  if (!(h->info & 1)) {
+    h = realloc(h, ARENA_HEADER + size);
+    assert(h);
+    h->info = size << 8;
+
+    return h + 1;
+  }
+
+  q = arena_malloc(size);
+  memcpy(q, p, old);
+  arena_release(p);
+
+  return q;
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
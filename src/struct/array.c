@@ -37,11 +37,13 @@ array *array_init()
 {
   array *arr = NULL;
 
-  arr = malloc(sizeof(array));
+  arr = arena_malloc(sizeof(array));
   assert(arr);
 
   arr->first = NULL;
   arr->last = NULL;
+  arr->size = 0;
+  arr->index = NULL;
 
   return arr;
 }
@@ -63,11 +65,12 @@ void array_free(array * a)
 
     buffer_free(an_to_free->key);
     buffer_free(an_to_free->value);
-    free(an_to_free);
+    arena_release(an_to_free);
     an_to_free = NULL;
   }
 
-  free(a);
+  if (a->index) hash_free(a->index);
+  arena_release(a);
   a = NULL;
 }
 
@@ -85,7 +88,7 @@ void array_add(array * a, buffer * key, buffer * value)
   assert(key);
   assert(value);
 
-  an = malloc(sizeof(array_node));
+  an = arena_malloc(sizeof(array_node));
   assert(an);
 
   an->key = key;
@@ -96,26 +99,45 @@ void array_add(array * a, buffer * key, buffer * value)
 
   a->last = an;
   a->last->next = NULL;
+  a->size++;
+
+  /* Index keys, once a linear search is no more cheap enough */
+  if (a->index) hash_add(a->index, key, an);
+  else if (a->size == HASH_MIN_ENTRIES) {
+    a->index = hash_init_like(a, true);
+    for (an = a->first ; an ; an = an->next) hash_add(a->index, an->key, an);
+  }
 }
 
 
 /*
- * Check if a given key string is or not in the array
+ * Return the first node matching a key, or NULL if none
  */
-bool array_is_key(const array * a, const char *key)
+static array_node *array_node_get(const array * a, const char *key)
 {
   array_node *an;
   size_t ks;
 
-  assert(a);
-  assert(key);
+  if (a->index) return hash_get(a->index, key);
 
   for (ks = strlen(key), an = a->first ; an ; an = an->next)
     if (ks == an->key->use)
       if (buffer_case_cmp(an->key, key))
-        return true;
+        return an;
 
-  return false;
+  return NULL;
+}
+
+
+/*
+ * Check if a given key string is or not in the array
+ */
+bool array_is_key(const array * a, const char *key)
+{
+  assert(a);
+  assert(key);
+
+  return array_node_get(a, key) ? true : false;
 }
 
 
@@ -147,17 +169,11 @@ bool array_is_value(const array * a, const char *value)
 buffer *array_get(const array * a, const char *key)
 {
   array_node *an;
-  size_t ks;
 
   assert(a);
   assert(key);
 
-  for (ks = strlen(key), an = a->first ; an ; an = an->next) {
-    if (ks == an->key->use)
-      if (buffer_case_cmp(an->key, key))
-        break;
-  }
-
+  an = array_node_get(a, key);
   assert(an);
 
   return an->value;
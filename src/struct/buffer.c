@@ -30,6 +30,12 @@
 #include <float.h>
 #include <regex.h>
 
+/* Aligned loads read past the string end, what AddressSanitizer reports */
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(__SANITIZE_ADDRESS__)
+#define BUFFER_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #include "../ows/ows.h"
 
 
@@ -38,20 +44,31 @@
 #endif
 
 /*
- * Realloc buffer memory space
- * use an exponential grow size to realloc (less realloc call)
+ * Make sure a buffer could receive n more chars (and the final '\0')
+ * Memory grows by power of two, so it fits arena size classes,
+ * and leave the inline storage once it's too short, for memory of the
+ * same kind than the buffer itself (so a heap buffer stays on heap)
  */
-static void buffer_realloc(buffer * buf)
+void buffer_reserve(buffer * buf, size_t n)
 {
+  size_t size;
+  char *p;
+
   assert(buf);
 
-  buf->buf = realloc(buf->buf, buf->realloc * sizeof(char));
-  assert(buf->buf);
+  if (buf->use + n < buf->size) return;
+  assert(buf->use + n < SIZE_MAX / 2);
+
+  for (size = BUFFER_SIZE_MIN ; size <= buf->use + n || size < buf->size * 2 ; size *= 2);
 
-  buf->size = buf->realloc;
-  buf->realloc *= 4;
+  if (buf->buf == buf->local) {
+    p = arena_malloc_like(buf, size * sizeof(char));
+    memcpy(p, buf->local, buf->use + 1);
+    buf->buf = p;
+  } else buf->buf = arena_realloc(buf->buf, size * sizeof(char));
 
-  if (buf->realloc >= SIZE_MAX) assert(false);
+  assert(buf->buf);
+  buf->size = size;
 }
 
 
@@ -62,14 +79,11 @@ buffer *buffer_init()
 {
   buffer *buf;
 
-  buf = malloc(sizeof(buffer));
+  buf = arena_malloc(sizeof(buffer));
   assert(buf);
 
-  buf->buf = malloc(BUFFER_SIZE_INIT * sizeof(char));
-  assert(buf->buf);
-
-  buf->size = BUFFER_SIZE_INIT;
-  buf->realloc = BUFFER_SIZE_INIT * 2;
+  buf->buf = buf->local;
+  buf->size = BUFFER_SIZE_INLINE;
   buf->use = 0;
   buf->buf[0] = '\0';
 
@@ -85,10 +99,10 @@ void buffer_free(buffer * buf)
   assert(buf);
   assert(buf->buf);
 
-  free(buf->buf);
+  if (buf->buf != buf->local) arena_release(buf->buf);
   buf->buf = NULL;
 
-  free(buf);
+  arena_release(buf);
   buf = NULL;
 }
 
@@ -124,7 +138,7 @@ void buffer_add(buffer * buf, char c)
 {
   assert(buf);
 
-  if ((buf->use + 1) >= buf->size) buffer_realloc(buf);
+  if ((buf->use + 1) >= buf->size) buffer_reserve(buf, 1);
 
   buf->buf[buf->use] = c;
   buf->buf[buf->use + 1] = '\0';
@@ -140,45 +154,175 @@ buffer *buffer_ftoa(double f)
   buffer *res;
 
   res = buffer_init();
-  while (res->size < 100) buffer_realloc(res);
-  #ifndef _WIN32
-  snprintf(res->buf, 99, "%f", f);
-  #else
-  _snprintf(res->buf, 99, "%f", f);
-  #endif 
-  res->use = strlen(res->buf);
+  buffer_add_double(res, f);
 
   return res;
 }
 
 
+static const double buffer_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+#define BUFFER_POW10_MAX 17
+#define BUFFER_2_52      4503599627370496.0
+#define BUFFER_2_53      9007199254740992.0
+
+
+/*
+ * Write an integer mantissa with frac decimals, i.e m * 10^-frac
+ */
+static size_t buffer_dtoa_digits(char *s, unsigned long long m, int frac, bool neg)
+{
+  char digits[24];
+  char *p;
+  int n;
+
+  for (n = 0 ; m || n <= frac ; m /= 10) digits[n++] = '0' + m % 10;
+
+  p = s;
+  if (neg) *p++ = '-';
+
+  while (n--) {
+    *p++ = digits[n];
+    if (n == frac && frac) *p++ = '.';
+  }
+  *p = '\0';
+
+  return p - s;
+}
+
+
+/*
+ * Write a double into s, which must be at least BUFFER_DOUBLE_SIZE long
+ * and return the length written.
+ *
+ * With a positive or null precision, output is the same than printf "%.*f".
+ * With a negative one, output is the shortest one reading back as the
+ * same double.
+ *
+ * Usual values (less than 2^53 once scaled) are handled with integer
+ * arithmetic only, others through printf. Decimal point is always '.'
+ * whatever the locale.
+ */
+size_t buffer_dtoa(char *s, double f, int precision)
+{
+  unsigned long long m;
+  double a, r, d;
+  char *p;
+  int i, len;
+
+  assert(s);
+
+  a = fabs(f);
+
+  if (isfinite(f) && precision >= 0 && precision <= BUFFER_POW10_MAX) {
+    r = a * buffer_pow10[precision];
+    if (r < BUFFER_2_52) {
+      m = (unsigned long long) r;
+      d = r - (double) m;
+
+      /* Scaling error could only change rounding direction near .5 */
+      if (fabs(d - 0.5) > r / BUFFER_2_52 * 4)
+        return buffer_dtoa_digits(s, m + (d > 0.5 ? 1 : 0), precision, signbit(f) ? true : false);
+    }
+  } else if (isfinite(f) && precision < 0) {
+    for (i = 0 ; i <= BUFFER_POW10_MAX ; i++) {
+      r = a * buffer_pow10[i];
+      if (r >= BUFFER_2_53) break;
+
+      m = (unsigned long long) (r + 0.5);
+      if ((double) m / buffer_pow10[i] == a)
+        return buffer_dtoa_digits(s, m, i, signbit(f) ? true : false);
+    }
+  }
+
+  if (precision >= 0) {
+    #ifndef _WIN32
+    len = snprintf(s, BUFFER_DOUBLE_SIZE, "%.*f", precision, f);
+    #else
+    len = _snprintf(s, BUFFER_DOUBLE_SIZE, "%.*f", precision, f);
+    #endif
+  } else {
+    /* Shortest of 15, 16 or 17 significant digits reading back the same */
+    for (i = 15 ; i <= 17 ; i++) {
+      #ifndef _WIN32
+      len = snprintf(s, BUFFER_DOUBLE_SIZE, "%.*g", i, f);
+      #else
+      len = _snprintf(s, BUFFER_DOUBLE_SIZE, "%.*g", i, f);
+      #endif
+      if (!isfinite(f) || strtod(s, NULL) == f) break;
+    }
+  }
+  assert(len > 0 && len < BUFFER_DOUBLE_SIZE);
+
+  for (p = s ; *p ; p++) if (*p == ',') *p = '.';
+
+  return len;
+}
+
+
 /*
- * Add a double to a given buffer
+ * Add a double to a given buffer, with the shortest digits
+ * reading back the same double
  */
 void buffer_add_double(buffer * buf, double f)
 {
-  buffer *b;
+  char s[BUFFER_DOUBLE_SIZE];
 
   assert(buf);
 
-  b = buffer_ftoa(f);
-  buffer_copy(buf, b);
-  buffer_free(b);
+  buffer_add_nstr(buf, s, buffer_dtoa(s, f, -1));
 }
 
 
 /*
- * Add an int to a given buffer
+ * Add a double to a given buffer, with a fixed number of decimals
  */
-void buffer_add_int(buffer * buf, int i)
+void buffer_add_double_fixed(buffer * buf, double f, int precision)
 {
-  buffer *b;
+  char s[BUFFER_DOUBLE_SIZE];
 
   assert(buf);
+  assert(precision >= 0);
 
-  b = buffer_itoa(i);
-  buffer_copy(buf, b);
-  buffer_free(b);
+  buffer_add_nstr(buf, s, buffer_dtoa(s, f, precision));
+}
+
+
+/*
+ * Add a long int to a given buffer (base 10 only)
+ * Digits are written from the end, without any intermediate string
+ */
+void buffer_add_long(buffer * buf, long int l)
+{
+  char s[24], *p;
+  unsigned long u;
+
+  assert(buf);
+
+  p = s + sizeof(s) - 1;
+  *p = '\0';
+  u = l < 0 ? 0UL - (unsigned long) l : (unsigned long) l;
+
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+
+  if (l < 0) *--p = '-';
+
+  buffer_add_nstr(buf, p, s + sizeof(s) - 1 - p);
+}
+
+
+/*
+ * Add an int to a given buffer
+ */
+void buffer_add_int(buffer * buf, int i)
+{
+  buffer_add_long(buf, i);
 }
 
 
@@ -190,10 +334,7 @@ buffer *buffer_itoa(int i)
   buffer *res;
 
   res = buffer_init();
-  /* FIXME use snprintf instead ! */
-  while (res->size < 100) buffer_realloc(res);
-  sprintf(res->buf, "%i", i);
-  res->use = strlen(res->buf);
+  buffer_add_long(res, i);
 
   return res;
 }
@@ -221,7 +362,7 @@ void buffer_add_head(buffer * buf, char c)
   assert(buf);
 
   if ((buf->use + 2) >= buf->size)
-    buffer_realloc(buf);
+    buffer_reserve(buf, 2);
 
   if (buf->use > 0)
     for (i = buf->use; i > 0; i--)
@@ -253,15 +394,16 @@ void buffer_add_head_str(buffer * buf, char *str)
  */
 void buffer_add_str(buffer * buf, const char *str)
 {
+  size_t len;
+
   assert(buf);
   assert(str);
 
-  if ((strlen(str) + buf->use) >= buf->size)
-    while ((strlen(str) + buf->use) >= buf->size)
-      buffer_realloc(buf);
+  len = strlen(str);
+  if (len + buf->use >= buf->size) buffer_reserve(buf, len);
 
-  strcat(buf->buf, str);
-  buf->use = buf->use + strlen(str);
+  memcpy(buf->buf + buf->use, str, len + 1);
+  buf->use += len;
 }
 
 
@@ -275,12 +417,11 @@ void buffer_add_nstr(buffer * buf, const char *str, size_t n)
   assert(n > 0);
   assert(n <= strlen(str));
 
-  if ((n + buf->use) >= buf->size) 
-    while ((n + buf->use) >= buf->size)
-      buffer_realloc(buf);
+  if ((n + buf->use) >= buf->size) buffer_reserve(buf, n);
 
-  strncat(buf->buf, str, n);
-  buf->use = buf->use + n;
+  memcpy(buf->buf + buf->use, str, n);
+  buf->use += n;
+  buf->buf[buf->use] = '\0';
 }
 
 
@@ -352,7 +493,10 @@ void buffer_copy(buffer * dest, const buffer * src)
   assert(dest);
   assert(src);
 
-  buffer_add_str(dest, src->buf);
+  if (src->use + dest->use >= dest->size) buffer_reserve(dest, src->use);
+
+  memmove(dest->buf + dest->use, src->buf, src->use + 1);
+  dest->use += src->use;
 }
 
 
@@ -489,91 +633,194 @@ long int buffer_rchr(const buffer * buf, char c)
 
 
 /*
- * Modify string to replace encoded characters by their true value
- * Function originaly written by Assefa
+ * Return the length of the leading part of a string free of any of
+ * the special chars (at most BUFFER_SPECIAL_MAX of them)
  *
- * The replacements performed are:
- *  & -> &amp;
- *  " -> &quot;
- *  < -> &lt;
- *  > -> &gt;
+ * With SSE2, 16 bytes are checked at once. Loads are aligned, so they
+ * never cross a page boundary, even when reading past the final '\0'
  */
-buffer *buffer_encode_xml_entities_str(const char * str)
+size_t buffer_clean_span(const char * str, const char * special)
 {
-  buffer *buf;
+#ifdef BUFFER_SSE2
+  __m128i chunk, hit, c[BUFFER_SPECIAL_MAX];
+  const char *p, *s;
+  int i, n, mask;
 
   assert(str);
-  buf = buffer_init();
+  assert(special);
 
-  for( /* empty */ ; *str ; str++) {
+  /* Scalar check until the first aligned address */
+  for (p = str ; ((size_t) p) & 15 ; p++) {
+    if (!*p) return p - str;
+    for (s = special ; *s ; s++)
+      if (*p == *s) return p - str;
+  }
 
-    switch(*str) {
-      case '&':
-        buffer_add_str(buf, "&amp;");
-        break;
+  n = strlen(special);
+  assert(n <= BUFFER_SPECIAL_MAX);
+  for (i = 0 ; i < n ; i++) c[i] = _mm_set1_epi8(special[i]);
 
-      case '<':
-        buffer_add_str(buf, "&lt;");
-        break;
+  for (/* empty */ ; ; p += 16) {
+    chunk = _mm_load_si128((const __m128i *) p);
+    hit = _mm_cmpeq_epi8(chunk, _mm_setzero_si128());
+    for (i = 0 ; i < n ; i++) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, c[i]));
 
-      case '>':
-        buffer_add_str(buf, "&gt;");
-        break;
+    mask = _mm_movemask_epi8(hit);
+    if (mask) {
+      for (i = 0 ; !(mask & 1) ; mask >>= 1, i++);
+      return p + i - str;
+    }
+  }
+#else
+  assert(str);
+  assert(special);
+
+  return strcspn(str, special);
+#endif
+}
 
-      case '"':
-        buffer_add_str(buf, "&quot;");
-        break;
 
-      case '\'':
-        buffer_add_str(buf, "&#39;");
-        break;
+#define BUFFER_XML_SPECIAL  "&<>\"'"
+#define BUFFER_JSON_SPECIAL "\"\n\r\t\\"
 
-      default:
-        buffer_add(buf, *str);
-    }
+/*
+ * Return the XML entity of a special char
+ */
+static const char *buffer_xml_entity(char c)
+{
+  switch(c) {
+    case '&':  return "&amp;";
+    case '<':  return "&lt;";
+    case '>':  return "&gt;";
+    case '"':  return "&quot;";
+    case '\'': return "&#39;";
   }
 
-  return buf;
+  assert(false);
+  return "";
+}
+
+
+/*
+ * Return the JSON escape sequence of a special char
+ */
+static const char *buffer_json_escape(char c)
+{
+  switch(c) {
+    case '"':  return "\\\"";
+    case '\n': return "\\\\n";
+    case '\r': return "\\\\r";
+    case '\t': return "\\\\t";
+    case '\\': return "\\\\";
+  }
+
+  assert(false);
+  return "";
+}
+
+
+/*
+ * Add a string to a buffer, with XML entities encoded
+ * Clean runs are copied at once
+ */
+void buffer_add_xml_entities(buffer * buf, const char * str)
+{
+  size_t n;
+
+  assert(buf);
+  assert(str);
+
+  for (;;) {
+    n = buffer_clean_span(str, BUFFER_XML_SPECIAL);
+    if (n) buffer_add_nstr(buf, str, n);
+
+    str += n;
+    if (!*str) return;
+
+    buffer_add_str(buf, buffer_xml_entity(*str++));
+  }
+}
+
+
+/*
+ * Write a string to a stream, with XML entities encoded
+ */
+void buffer_fputs_xml_entities(const char * str, FILE * output)
+{
+  size_t n;
+
+  assert(str);
+  assert(output);
+
+  for (;;) {
+    n = buffer_clean_span(str, BUFFER_XML_SPECIAL);
+    if (n) fwrite(str, 1, n, output);
+
+    str += n;
+    if (!*str) return;
+
+    fputs(buffer_xml_entity(*str++), output);
+  }
+}
+
+
+/*
+ * Add a string to a buffer, escaped for JSON output
+ */
+void buffer_add_json_str(buffer * buf, const char * str)
+{
+  size_t n;
+
+  assert(buf);
+  assert(str);
+
+  for (;;) {
+    n = buffer_clean_span(str, BUFFER_JSON_SPECIAL);
+    if (n) buffer_add_nstr(buf, str, n);
+
+    str += n;
+    if (!*str) return;
+
+    buffer_add_str(buf, buffer_json_escape(*str++));
+  }
 }
 
 
 /*
  * Modify string to replace encoded characters by their true value
- * for JSON output
+ * Function originaly written by Assefa
+ *
+ * The replacements performed are:
+ *  & -> &amp;
+ *  " -> &quot;
+ *  < -> &lt;
+ *  > -> &gt;
  */
-buffer *buffer_encode_json_str(const char * str)
+buffer *buffer_encode_xml_entities_str(const char * str)
 {
   buffer *buf;
 
   assert(str);
-  buf = buffer_init();
 
-  for( /* empty */ ; *str ; str++) {
-    switch(*str) {
-      case '"':
-        buffer_add_str(buf, "\\\"");
-        break;
+  buf = buffer_init();
+  buffer_add_xml_entities(buf, str);
 
-      case '\n':
-        buffer_add_str(buf, "\\\\n");
-        break;
+  return buf;
+}
 
-      case '\r':
-        buffer_add_str(buf, "\\\\r");
-        break;
 
-      case '\t':
-        buffer_add_str(buf, "\\\\t");
-        break;
+/*
+ * Modify string to replace encoded characters by their true value
+ * for JSON output
+ */
+buffer *buffer_encode_json_str(const char * str)
+{
+  buffer *buf;
 
-      case '\\':
-        buffer_add_str(buf, "\\\\");
-        break;
+  assert(str);
 
-      default:
-        buffer_add(buf, *str);
-    }
-  }
+  buf = buffer_init();
+  buffer_add_json_str(buf, str);
 
   return buf;
 }
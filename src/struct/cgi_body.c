@@ -0,0 +1,172 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+/*
+ * POST request body
+ *
+ * Body is read by chunks from stdin. A small body stays in memory,
+ * a large one (above request_spool_size) is written to an unlinked
+ * temporary file and then mmapped, so that parsers read it as a plain
+ * string without holding it in the process heap.
+ */
+
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "../ows/ows.h"
+
+
+#define CGI_BODY_CHUNK 65536
+
+
+/*
+ * Read size bytes from stdin into s
+ * Return false if input ends before
+ */
+static bool cgi_body_fread(char *s, size_t size)
+{
+  size_t n;
+
+  while (size) {
+    n = fread(s, 1, size < CGI_BODY_CHUNK ? size : CGI_BODY_CHUNK, stdin);
+    if (!n) return false;
+    s += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+
+#ifndef _WIN32
+/*
+ * Spool the body to a temporary file and map it
+ * File is unlinked at once, and so removed whatever happens
+ */
+static char *cgi_body_spool(ows * o, size_t size)
+{
+  char chunk[CGI_BODY_CHUNK];
+  char path[1024];
+  const char *dir;
+  size_t n, left;
+  char *body;
+  int fd;
+
+  dir = getenv("TMPDIR");
+  if (!dir || !*dir) dir = "/tmp";
+  if (snprintf(path, sizeof(path), "%s/tinyows-XXXXXX", dir) >= (int) sizeof(path)) return NULL;
+
+  fd = mkstemp(path);
+  if (fd == -1) return NULL;
+  unlink(path);
+
+  for (left = size ; left ; left -= n) {
+    n = fread(chunk, 1, left < CGI_BODY_CHUNK ? left : CGI_BODY_CHUNK, stdin);
+    if (!n || write(fd, chunk, n) != (ssize_t) n) {
+      close(fd);
+      return NULL;
+    }
+  }
+
+  /* Parsers expect a NUL terminated string */
+  if (write(fd, "", 1) != 1) {
+    close(fd);
+    return NULL;
+  }
+
+  /* Private mapping, as KVP parsing unescapes the string in place */
+  body = mmap(NULL, size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (body == MAP_FAILED) return NULL;
+
+  o->query_mapped = size + 1;
+
+  return body;
+}
+#endif
+
+
+/*
+ * Read a POST body of a given size
+ * Return NULL on error
+ */
+char *cgi_body_read(ows * o, size_t size)
+{
+  char *body;
+
+  assert(o);
+
+#ifndef _WIN32
+  if (o->request_spool_size && size > o->request_spool_size)
+    return cgi_body_spool(o, size);
+#endif
+
+  body = malloc(size + 1);
+  if (!body) return NULL;
+
+  if (!cgi_body_fread(body, size)) {
+    free(body);
+    return NULL;
+  }
+  body[size] = '\0';
+
+  return body;
+}
+
+
+/*
+ * Release a POST body
+ */
+void cgi_body_free(ows * o, char *body)
+{
+  assert(o);
+  assert(body);
+
+#ifndef _WIN32
+  if (o->query_mapped) {
+    munmap(body, o->query_mapped);
+    o->query_mapped = 0;
+    return;
+  }
+#endif
+
+  free(body);
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -64,28 +64,37 @@ bool cgi_method_post()
 
 /*
  * Return the string sent by CGI
+ * POST body size is checked before anything is read
  */
 char *cgi_getback_query(ows * o)
 {
-  char *query;
-  int query_size = 0;
-  size_t s;
+  char *query, *length, *end;
+  unsigned long query_size;
 
   if (cgi_method_get()) query = getenv("QUERY_STRING");
   else if (cgi_method_post()) {
-    query_size = atoi(getenv("CONTENT_LENGTH"));
+    length = getenv("CONTENT_LENGTH");
+    if (!length || !*length) {
+      ows_error(o, OWS_ERROR_REQUEST_HTTP, "Error on QUERY input - CONTENT_LENGTH is not set", "request");
+      return NULL;
+    }
 
-    query = malloc(sizeof(char) * query_size + 1);
-    if (!query) {
-      ows_error(o, OWS_ERROR_REQUEST_HTTP, "Error on QUERY input - Memory allocation", "request");
+    query_size = strtoul(length, &end, 10);
+    if (*end || length[0] == '-') {
+      ows_error(o, OWS_ERROR_REQUEST_HTTP, "Error on QUERY input - CONTENT_LENGTH is not valid", "request");
       return NULL;
     }
-    s = fread(query, query_size, 1, stdin);
-    if (ferror(stdin)) {
+
+    if (o->request_max_size && query_size > o->request_max_size) {
+      ows_error(o, OWS_ERROR_REQUEST_TOO_LARGE, "Error on QUERY input - Request is too large", "request");
+      return NULL;
+    }
+
+    query = cgi_body_read(o, query_size);
+    if (!query) {
       ows_error(o, OWS_ERROR_REQUEST_HTTP, "Error on QUERY input", "request");
       return NULL;
     }
-    query[query_size] = '\0';
   }
   /* local tests */
   else query = getenv("QUERY_STRING");
@@ -432,13 +441,17 @@ static bool is_node_ns_wfs(xmlNodePtr n)
 
 /*
  * Parse the XML request and return an array key/value
+ * Document is kept in the request, to be validated and used as is later.
+ * A Transaction is only read up to its root element, as its operations
+ * are streamed later (see wfs_parse_operation)
  */
 array *cgi_parse_xml(ows * o, char *query)
 {
-  buffer *key, *val, *operations, *prop, *filter, *typename;
+  buffer *key, *val, *prop, *filter, *typename;
   bool prop_need_comma, typ_need_comma;
-  xmlDocPtr xmldoc;
+  xmlTextReaderPtr reader;
   xmlAttr *att;
+  int ret;
   array *arr, *o_ns;
   bool lock_error, unknown_error;
   xmlNodePtr node, n = NULL;
@@ -449,17 +462,33 @@ array *cgi_parse_xml(ows * o, char *query)
   prop_need_comma = typ_need_comma = false;
   lock_error = unknown_error = false;
 
-  xmldoc = xmlParseMemory(query, strlen(query));
+  reader = xmlReaderForMemory(query, strlen(query), NULL, NULL, 0);
+
+  /* Root element */
+  ret = reader ? xmlTextReaderRead(reader) : -1;
+  while (ret == 1 && xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+    ret = xmlTextReaderRead(reader);
 
-  if (!xmldoc || !(n = xmlDocGetRootElement(xmldoc))) {
-    xmlFreeDoc(xmldoc);
+  if (ret == 1) n = xmlTextReaderCurrentNode(reader);
+
+  /* Whole document is needed, unless for a Transaction
+     (so far the reader only parsed the beginning of the request) */
+  if (n && strcmp((char *) n->name, "Transaction")) {
+    xmlFreeTextReader(reader);
+    reader = NULL;
+
+    o->request->doc = xmlParseMemory(query, strlen(query));
+    n = o->request->doc ? xmlDocGetRootElement(o->request->doc) : NULL;
+  }
+
+  if (!n) {
+    if (reader) xmlFreeTextReader(reader);
     ows_error(o, OWS_ERROR_INVALID_PARAMETER_VALUE, "XML isn't valid", "request");
     return NULL;
   }
 
   arr = array_init();
 
-  operations = buffer_init();
   prop = buffer_init();;
   filter = buffer_init();
   typename = buffer_init();
@@ -482,7 +511,10 @@ array *cgi_parse_xml(ows * o, char *query)
   for (att = n->properties ; att ; att = att->next)
     arr = cgi_add_att(arr, att);
 
-  for (n = n->children; n; n = n->next) {
+  if (!strcmp((char *) n->name, "Transaction")) n = NULL;
+  else n = n->children;
+
+  for ( /* empty */ ; n; n = n->next) {
     if (n->type != XML_ELEMENT_NODE) continue; /* Eat spaces */
     if (!is_node_ns_wfs(n)) continue;          /* NS check */
 
@@ -509,15 +541,6 @@ array *cgi_parse_xml(ows * o, char *query)
       typename = cgi_add_into_buffer(typename, n, typ_need_comma);
       typ_need_comma = true;
     } else if (is_node_ns_wfs(n) && !strcmp((char *) n->name, "LockID")) lock_error = true;
-    /* If it's an operation, keep the xml to analyze it later */
-    else if (  is_node_ns_wfs(n)
-               && (    !strcmp((char *) n->name, "Insert")
-                    || !strcmp((char *) n->name, "Delete")
-                    || !strcmp((char *) n->name, "Update"))) {
-
-      if (!operations->use) buffer_add_str(operations, "<operations>");
-      operations = cgi_add_xml_into_buffer(operations, n); /* Add the whole xml operation to the buffer */
-    }
     /* if node name match 'Query', parse the children elements */
     else if (is_node_ns_wfs(n) && !strcmp((char *) n->name, "Query")) {
       /* each query's propertynames and filter must be in brackets */
@@ -533,8 +556,9 @@ array *cgi_parse_xml(ows * o, char *query)
           prop = cgi_add_into_buffer(prop, node, prop_need_comma);
           prop_need_comma = true;
         } else if (is_node_ns_wfs(node) && !strcmp((char *) node->name, "Filter")) {
-          /* add the whole xml filter to the matching global buffer */
-          filter = cgi_add_xml_into_buffer(filter, node);
+          /* Filter element itself is used from the request document,
+             only mark its place in the matching global buffer */
+          buffer_add_str(filter, "Filter");
         } else if (is_node_ns_wfs(node) && !strcmp((char *) node->name, "SortBy")) {
           /* add sortby element to the array */
           arr = cgi_add_sortby(arr, node);
@@ -557,12 +581,6 @@ array *cgi_parse_xml(ows * o, char *query)
     } else unknown_error = true;
   }
 
-  /* operations */
-  if (operations->use) {
-    buffer_add_str(operations, "</operations>");
-    arr = cgi_add_buffer(arr, operations, "operations");
-  }
-
   /* propertyname */
   if (prop->use) {
     /* if buffer just contains a series of (*), propertyname not useful */
@@ -583,12 +601,11 @@ array *cgi_parse_xml(ows * o, char *query)
   if (typename->use) arr = cgi_add_buffer(arr, typename, "typename");
 
   buffer_free(prop);
-  buffer_free(operations);
   buffer_free(filter);
   buffer_free(typename);
   array_free(o_ns);
 
-  xmlFreeDoc(xmldoc);
+  if (reader) xmlFreeTextReader(reader);
 
   if (lock_error) {
     array_free(arr);
@@ -0,0 +1,243 @@
+/*
+  Copyright (c) <2007-2012> <Barbara Philippot - Olivier Courtin>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+
+/*
+ * Hash index on buffer keys
+ *
+ * Used by containers to look for a key in constant time, while they keep
+ * their own nodes chain (and so their insertion order) to iterate.
+ * Open addressing with linear probing, table size is a power of two
+ * and never more than half full.
+ * Keys are not owned by the index, only referenced.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "../ows/ows.h"
+
+
+/*
+ * FNV-1a hash of a string, optionnaly case insensitive
+ */
+static size_t hash_str(const char *str, size_t len, bool nocase)
+{
+  size_t h, i;
+
+  for (h = 2166136261U, i = 0 ; i < len ; i++) {
+    h ^= nocase ? (unsigned char) toupper((unsigned char) str[i]) : (unsigned char) str[i];
+    h *= 16777619U;
+  }
+
+  return h;
+}
+
+
+/*
+ * Set up an allocated hash index structure
+ * Slots are of the same kind (arena or heap) than the structure
+ */
+static hash *hash_setup(hash * h, bool nocase)
+{
+  assert(h);
+
+  h->size = HASH_SIZE_INIT;
+  h->count = 0;
+  h->nocase = nocase;
+  h->slots = arena_malloc_like(h, h->size * sizeof(hash_slot));
+  assert(h->slots);
+  memset(h->slots, 0, h->size * sizeof(hash_slot));
+
+  return h;
+}
+
+
+/*
+ * Initialize a hash index structure
+ */
+hash *hash_init(bool nocase)
+{
+  return hash_setup(arena_malloc(sizeof(hash)), nocase);
+}
+
+
+/*
+ * Initialize a hash index structure of the same kind (arena or heap)
+ * than its owner, as containers index themselves lazily, maybe during
+ * a request for a long lived one
+ */
+hash *hash_init_like(const void *owner, bool nocase)
+{
+  return hash_setup(arena_malloc_like(owner, sizeof(hash)), nocase);
+}
+
+
+/*
+ * Free a hash index structure (but neither keys nor values)
+ */
+void hash_free(hash * h)
+{
+  assert(h);
+
+  arena_release(h->slots);
+  arena_release(h);
+  h = NULL;
+}
+
+
+/*
+ * Find the slot of a key, or the empty one where it would be inserted
+ */
+static hash_slot *hash_slot_find(const hash * h, const char *key, size_t len, size_t hk)
+{
+  hash_slot *s;
+  size_t i;
+
+  for (i = hk & (h->size - 1) ; h->slots[i].key ; i = (i + 1) & (h->size - 1)) {
+    s = &(h->slots[i]);
+    if (s->hash != hk || s->key->use != len) continue;
+
+    if (h->nocase && buffer_case_cmp(s->key, key)) return s;
+    if (!h->nocase && !memcmp(s->key->buf, key, len)) return s;
+  }
+
+  return &(h->slots[i]);
+}
+
+
+/*
+ * Double the table size, and put all slots back
+ * Slots memory keeps its kind (arena or heap), as long lived containers
+ * could grow during a request
+ */
+static void hash_grow(hash * h)
+{
+  hash_slot *old, *s;
+  size_t i, size;
+
+  size = h->size;
+  old = arena_malloc(size * sizeof(hash_slot));
+  assert(old);
+  memcpy(old, h->slots, size * sizeof(hash_slot));
+
+  h->size *= 2;
+  h->slots = arena_realloc(h->slots, h->size * sizeof(hash_slot));
+  assert(h->slots);
+  memset(h->slots, 0, h->size * sizeof(hash_slot));
+
+  for (i = 0 ; i < size ; i++) {
+    if (!old[i].key) continue;
+    s = hash_slot_find(h, old[i].key->buf, old[i].key->use, old[i].hash);
+    *s = old[i];
+  }
+
+  arena_release(old);
+}
+
+
+/*
+ * Index a value under a key
+ * If key is already indexed, first value is kept
+ * Carefull key is referenced, so must live as long as the index
+ */
+void hash_add(hash * h, buffer * key, void *value)
+{
+  hash_slot *s;
+  size_t hk;
+
+  assert(h);
+  assert(key);
+
+  if (2 * (h->count + 1) > h->size) hash_grow(h);
+
+  hk = hash_str(key->buf, key->use, h->nocase);
+  s = hash_slot_find(h, key->buf, key->use, hk);
+  if (s->key) return;
+
+  s->key = key;
+  s->value = value;
+  s->hash = hk;
+  h->count++;
+}
+
+
+/*
+ * Remove a key from the index
+ * Following slots of the probe chain are shifted back, so no lookup
+ * could stop too early on the freed slot
+ */
+void hash_remove(hash * h, const buffer * key)
+{
+  hash_slot *s;
+  size_t i, j, k, mask;
+
+  assert(h);
+  assert(key);
+
+  s = hash_slot_find(h, key->buf, key->use, hash_str(key->buf, key->use, h->nocase));
+  if (!s->key) return;
+
+  mask = h->size - 1;
+  i = s - h->slots;
+  s->key = NULL;
+  s->value = NULL;
+  h->count--;
+
+  for (j = (i + 1) & mask ; h->slots[j].key ; j = (j + 1) & mask) {
+    k = h->slots[j].hash & mask;
+
+    /* Slot stays where it is if its home is cyclically in ]i, j] */
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+
+    h->slots[i] = h->slots[j];
+    h->slots[j].key = NULL;
+    h->slots[j].value = NULL;
+    i = j;
+  }
+}
+
+
+/*
+ * Return the value indexed under a key, or NULL if none
+ */
+void *hash_get(const hash * h, const char *key)
+{
+  size_t len;
+
+  assert(h);
+  assert(key);
+
+  len = strlen(key);
+
+  return hash_slot_find(h, key, len, hash_str(key, len, h->nocase))->value;
+}
+
+
+/*
+ * vim: expandtab sw=4 ts=4
+ */
@@ -37,12 +37,13 @@ list *list_init()
 {
   list *l = NULL;
 
-  l = malloc(sizeof(list));
+  l = arena_malloc(sizeof(list));
   assert(l);
 
   l->first = NULL;
   l->last = NULL;
   l->size = 0;
+  l->index = NULL;
 
   return l;
 }
@@ -55,10 +56,13 @@ void list_free(list * l)
 {
   assert(l);
 
+  if (l->index) hash_free(l->index);
+  l->index = NULL;
+
   while (l->first) list_node_free(l, l->first);
 
   l->last = NULL;
-  free(l);
+  arena_release(l);
   l = NULL;
 }
 
@@ -91,6 +95,8 @@ void list_add(list * l, buffer * value)
   l->last = ln;
   l->last->next = NULL;
   l->size++;
+
+  if (l->index) hash_add(l->index, ln->value, ln);
 }
 
 
@@ -123,6 +129,22 @@ void list_add_str(list * l, char *value)
   l->last = ln;
   l->last->next = NULL;
   l->size++;
+
+  if (l->index) hash_add(l->index, ln->value, ln);
+}
+
+
+/*
+ * Remove a node value from the list index, if the node is the indexed one
+ * (i.e the first one holding this value)
+ */
+static void list_unindex(list * l, list_node * ln)
+{
+  assert(l);
+  assert(ln);
+
+  if (l->index && ln->value && hash_get(l->index, ln->value->buf) == ln)
+    hash_remove(l->index, ln->value);
 }
 
 
@@ -133,14 +155,15 @@ void list_pop(list *l)
   assert(l);
   if (l->size == 0) return;
 
-  ln = l->last->prev;
-  list_node_free(l, l->last);
-  ln->next = NULL; 
-  l->last = ln;
+  ln = l->last;
+  l->last = ln->prev;
+  if (l->last) l->last->next = NULL;
+  else         l->first = NULL;
   l->size--;
 
-  if (l->size == 0) l->first = l->last = NULL;
-  if (l->size == 1) l->first = l->last = ln;
+  ln->prev = NULL;
+  list_unindex(l, ln);
+  list_node_free(NULL, ln);
 }
 
 
@@ -174,6 +197,8 @@ void list_add_list(list * l, list * l_to_add)
       l->last = ln;
       l->last->next = NULL;
       l->size++;
+
+      if (l->index) hash_add(l->index, ln->value, ln);
     }
   }
 }
@@ -210,6 +235,8 @@ void list_add_by_copy(list * l, buffer * value)
   l->last = ln;
   l->last->next = NULL;
   l->size++;
+
+  if (l->index) hash_add(l->index, ln->value, ln);
 }
 
 
@@ -220,7 +247,7 @@ list_node *list_node_init()
 {
   list_node *ln;
 
-  ln = malloc(sizeof(list_node));
+  ln = arena_malloc(sizeof(list_node));
   assert(ln);
 
   ln->value = NULL;
@@ -246,13 +273,33 @@ void list_node_free(list * l, list_node * ln)
     if (l) l->first = NULL;
   }
 
+  if (l) list_unindex(l, ln);
   if (ln->value) buffer_free(ln->value);
 
-  free(ln);
+  arena_release(ln);
   ln = NULL;
 }
 
 
+/*
+ * Index list values, so in_list() lookups no more scan the whole list
+ * Worth it for lists looked up for each column or each feature.
+ * Careful values must not be modified in place once indexed,
+ * and are expected to be distinct: removing a node unindexes its value
+ */
+void list_index(list * l)
+{
+  list_node *ln;
+
+  assert(l);
+
+  if (l->index) hash_free(l->index);
+  l->index = hash_init_like(l, false);
+
+  for (ln = l->first ; ln ; ln = ln->next) hash_add(l->index, ln->value, ln);
+}
+
+
 /*
  * Check if a given buffer value is or not in the list
  */
@@ -263,6 +310,8 @@ bool in_list(const list * l, const buffer * value)
   assert(l);
   assert(value);
 
+  if (l->index) return hash_get(l->index, value->buf) ? true : false;
+
   for (ln = l->first ; ln ; ln = ln->next)
     if (value->use == ln->value->use)
       if (buffer_cmp(value, ln->value->buf))
@@ -282,6 +331,8 @@ bool in_list_str(const list * l, const char * value)
   assert(l);
   assert(value);
 
+  if (l->index) return hash_get(l->index, value) ? true : false;
+
   for (ln = l->first ; ln ; ln = ln->next)
     if (!strcmp(value, ln->value->buf)) return true;
 
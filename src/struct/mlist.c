@@ -37,7 +37,7 @@ mlist *mlist_init()
 {
   mlist *ml = NULL;
 
-  ml = malloc(sizeof(mlist));
+  ml = arena_malloc(sizeof(mlist));
   assert(ml);
 
   ml->first = NULL;
@@ -58,7 +58,7 @@ void mlist_free(mlist * ml)
   while (ml->first) mlist_node_free(ml, ml->first);
 
   ml->last = NULL;
-  free(ml);
+  arena_release(ml);
   ml = NULL;
 }
 
@@ -101,7 +101,7 @@ mlist_node *mlist_node_init()
 {
   mlist_node *mln;
 
-  mln = malloc(sizeof(mlist_node));
+  mln = arena_malloc(sizeof(mlist_node));
   assert(mln);
 
   mln->value = NULL;
@@ -131,7 +131,7 @@ void mlist_node_free(mlist * ml, mlist_node * mln)
 
   if (mln->value) list_free(mln->value);
 
-  free(mln);
+  arena_release(mln);
   mln = NULL;
 }
 
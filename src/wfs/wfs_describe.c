@@ -181,6 +181,7 @@ void wfs_describe_feature_type(ows * o, wfs_request * wr)
     return;
   }
 
+  ows_timing_header(o);
   if (wr->format == WFS_GML212 || wr->format == WFS_XML_SCHEMA)
     fprintf(o->output, "Content-Type: text/xml; subtype=gml/2.1.2;\n\n");
   else if (wr->format == WFS_GML311)
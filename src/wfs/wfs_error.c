@@ -31,7 +31,7 @@
 /*
  * Transform an error code into an error message
  */
-static char *wfs_error_code_string(enum wfs_error_code code)
+char *wfs_error_code_string(enum wfs_error_code code)
 {
   switch (code) {
     case WFS_ERROR_INVALID_VERSION:
@@ -130,7 +130,10 @@ void wfs_error(ows * o, wfs_request * wf, enum wfs_error_code code, char *messag
   assert(message);
   assert(locator);
 
+  o->metrics->wfs_errors[code]++;
+
   version = ows_version_get(o->request->version);
+  ows_timing_header(o);
   fprintf(o->output, "Content-Type: application/xml\n\n");
 
   switch (version) {
@@ -215,6 +215,8 @@ static void wfs_feature_type_list(ows * o)
   list_node *keyword, *l_srid;
   int s;
   bool writable, retrievable;
+  char west[BUFFER_DOUBLE_SIZE], east[BUFFER_DOUBLE_SIZE];
+  char south[BUFFER_DOUBLE_SIZE], north[BUFFER_DOUBLE_SIZE];
 
   assert(o);
 
@@ -384,33 +386,20 @@ static void wfs_feature_type_list(ows * o)
         fprintf(o->output, " <ows:WGS84BoundingBox>");
 
       if (gb->east != DBL_MIN) {
-        if (ows_version_get(o->request->version) == 100) {
-          if (gb->west < gb->east)
-            fprintf(o->output, " minx='%.*f'", o->degree_precision, gb->west);
-          else
-            fprintf(o->output, " minx='%.*f'", o->degree_precision, gb->east);
-
-          if (gb->north < gb->south)
-            fprintf(o->output, " miny='%.*f'", o->degree_precision, gb->north);
-          else
-            fprintf(o->output, " miny='%.*f'", o->degree_precision, gb->south);
-
-          if (gb->west < gb->east)
-            fprintf(o->output, " maxx='%.*f'", o->degree_precision, gb->east);
-          else
-            fprintf(o->output, " maxx='%.*f'", o->degree_precision, gb->west);
-
-          if (gb->north < gb->south)
-            fprintf(o->output, " maxy='%.*f'", o->degree_precision, gb->south);
-          else
-            fprintf(o->output, " maxy='%.*f'", o->degree_precision, gb->north);
+        buffer_dtoa(west, gb->west, o->degree_precision);
+        buffer_dtoa(east, gb->east, o->degree_precision);
+        buffer_dtoa(south, gb->south, o->degree_precision);
+        buffer_dtoa(north, gb->north, o->degree_precision);
 
+        if (ows_version_get(o->request->version) == 100) {
+          fprintf(o->output, " minx='%s'", gb->west < gb->east ? west : east);
+          fprintf(o->output, " miny='%s'", gb->north < gb->south ? north : south);
+          fprintf(o->output, " maxx='%s'", gb->west < gb->east ? east : west);
+          fprintf(o->output, " maxy='%s'", gb->north < gb->south ? south : north);
           fprintf(o->output, " />\n");
         } else if (ows_version_get(o->request->version) == 110) {
-          fprintf(o->output, " <ows:LowerCorner>%.*f %.*f</ows:LowerCorner>",
-                  o->degree_precision, gb->west, o->degree_precision, gb->south);
-          fprintf(o->output, " <ows:UpperCorner>%.*f %.*f</ows:UpperCorner>",
-                  o->degree_precision, gb->east, o->degree_precision, gb->north);
+          fprintf(o->output, " <ows:LowerCorner>%s %s</ows:LowerCorner>", west, south);
+          fprintf(o->output, " <ows:UpperCorner>%s %s</ows:UpperCorner>", east, north);
         }
       } else {
         if (ows_version_get(o->request->version) == 100) {
@@ -446,6 +435,7 @@ static void wfs_get_capabilities_110(ows * o, wfs_request * wr)
   assert(o);
   assert(wr);
 
+  ows_timing_header(o);
   if (wr->format == WFS_TEXT_XML)
     fprintf(o->output, "Content-Type: text/xml\n\n");
   else
@@ -538,6 +528,7 @@ static void wfs_get_capabilities_100(ows * o, wfs_request * wr)
   assert(o);
   assert(wr);
 
+  ows_timing_header(o);
   fprintf(o->output, "Content-Type: application/xml\n\n");
   fprintf(o->output, "<?xml version='1.0' encoding='%s'?>\n", o->encoding->buf);
   fprintf(o->output, "<WFS_Capabilities\n");
@@ -37,6 +37,7 @@
  */
 static void wfs_gml_bounded_by(ows * o, wfs_request * wr, double xmin, double ymin, double xmax, double ymax, ows_srs * srs)
 {
+  char x1[BUFFER_DOUBLE_SIZE], y1[BUFFER_DOUBLE_SIZE], x2[BUFFER_DOUBLE_SIZE], y2[BUFFER_DOUBLE_SIZE];
   int precision;
 
   assert(o);
@@ -46,6 +47,10 @@ static void wfs_gml_bounded_by(ows * o, wfs_request * wr, double xmin, double ym
   if (srs->is_degree) precision = o->degree_precision;
   else precision = o->meter_precision;
 
+  /* Huge values are written with their shortest form */
+  if (fabs(xmin) > OWS_MAX_DOUBLE || fabs(ymin) > OWS_MAX_DOUBLE ||
+      fabs(xmax) > OWS_MAX_DOUBLE || fabs(ymax) > OWS_MAX_DOUBLE) precision = -1;
+
   if (!srs->srid || srs->srid == -1 || (xmin == ymin && xmax == ymax && xmin == xmax)) {
     if (ows_version_get(o->request->version) == 100)
       fprintf(o->output, "<gml:boundedBy><gml:null>missing</gml:null></gml:boundedBy>\n");
@@ -54,6 +59,11 @@ static void wfs_gml_bounded_by(ows * o, wfs_request * wr, double xmin, double ym
   } else {
     fprintf(o->output, "<gml:boundedBy>\n");
 
+    buffer_dtoa(x1, xmin, precision);
+    buffer_dtoa(y1, ymin, precision);
+    buffer_dtoa(x2, xmax, precision);
+    buffer_dtoa(y2, ymax, precision);
+
     if (wr->format == WFS_GML212) {
       fprintf(o->output, "  <gml:Box srsName=\"");
       if (strcmp(srs->auth_name->buf, "EPSG")) fprintf(o->output, "%s:", srs->auth_name->buf);
@@ -61,12 +71,8 @@ static void wfs_gml_bounded_by(ows * o, wfs_request * wr, double xmin, double ym
       else fprintf(o->output, "EPSG:");
       fprintf(o->output, "%d\">", srs->srid);
 
-      if (fabs(xmin) > OWS_MAX_DOUBLE || fabs(ymin) > OWS_MAX_DOUBLE ||
-          fabs(xmax) > OWS_MAX_DOUBLE || fabs(ymax) > OWS_MAX_DOUBLE)
-        fprintf(o->output, "<gml:coordinates decimal=\".\" cs=\",\" ts=\" \">%g,%g %g,%g</gml:coordinates>",
-                xmin, ymin, xmax, ymax);
-      else fprintf(o->output, "<gml:coordinates decimal=\".\" cs=\",\" ts=\" \">%.*f,%.*f %.*f,%.*f</gml:coordinates>",
-                     precision, xmin, precision, ymin, precision, xmax, precision, ymax);
+      fprintf(o->output, "<gml:coordinates decimal=\".\" cs=\",\" ts=\" \">%s,%s %s,%s</gml:coordinates>",
+              x1, y1, x2, y2);
       fprintf(o->output, "</gml:Box>\n");
 
     } else if (wr->format == WFS_GML311) {
@@ -77,23 +83,11 @@ static void wfs_gml_bounded_by(ows * o, wfs_request * wr, double xmin, double ym
       fprintf(o->output, "%d\">", srs->srid);
 
       if (srs->is_reverse_axis && !srs->is_eastern_axis && srs->is_long) {
-        if (fabs(xmin) > OWS_MAX_DOUBLE || fabs(ymin) > OWS_MAX_DOUBLE ||
-            fabs(xmax) > OWS_MAX_DOUBLE || fabs(ymax) > OWS_MAX_DOUBLE) {
-          fprintf(o->output, "<gml:lowerCorner>%g %g</gml:lowerCorner>", ymin, xmin);
-          fprintf(o->output, "<gml:upperCorner>%g %g</gml:upperCorner>", ymax, xmax);
-        } else {
-          fprintf(o->output, "<gml:lowerCorner>%.*f %.*f</gml:lowerCorner>", precision, ymin, precision, xmin);
-          fprintf(o->output, "<gml:upperCorner>%.*f %.*f</gml:upperCorner>", precision, ymax, precision, xmax);
-        }
+        fprintf(o->output, "<gml:lowerCorner>%s %s</gml:lowerCorner>", y1, x1);
+        fprintf(o->output, "<gml:upperCorner>%s %s</gml:upperCorner>", y2, x2);
       } else {
-        if (fabs(xmin) > OWS_MAX_DOUBLE || fabs(ymin) > OWS_MAX_DOUBLE ||
-            fabs(xmax) > OWS_MAX_DOUBLE || fabs(ymax) > OWS_MAX_DOUBLE) {
-          fprintf(o->output, "<gml:lowerCorner>%g %g</gml:lowerCorner>", xmin, ymin);
-          fprintf(o->output, "<gml:upperCorner>%g %g</gml:upperCorner>", xmax, ymax);
-        } else {
-          fprintf(o->output, "<gml:lowerCorner>%.*f %.*f</gml:lowerCorner>", precision, xmin, precision, ymin);
-          fprintf(o->output, "<gml:upperCorner>%.*f %.*f</gml:upperCorner>", precision, xmax, precision, ymax);
-        }
+        fprintf(o->output, "<gml:lowerCorner>%s %s</gml:lowerCorner>", x1, y1);
+        fprintf(o->output, "<gml:upperCorner>%s %s</gml:upperCorner>", x2, y2);
       }
       fprintf(o->output, "</gml:Envelope>\n");
     }
@@ -104,70 +98,66 @@ static void wfs_gml_bounded_by(ows * o, wfs_request * wr, double xmin, double ym
 
 
 /*
- * Display the properties of one feature
+ * Display the property of one feature
  */
-void wfs_gml_display_feature(ows * o, wfs_request * wr,
-                             buffer * layer_name, buffer * prefix,
-                             char * prop_name, buffer * prop_type, char * value)
+static void wfs_gml_display_feature(ows * o, const wfs_column * col, buffer * prefix, char * value)
 {
-  buffer *time, *pkey, *value_encoded, *prop_name_buffer;
-  bool gml_ns = false;
-  assert(layer_name && prop_name);
-  assert(prop_type);
-  assert(prefix);
-  assert(value);
-  assert(layer_name && prop_name && prop_type && prefix && value && wr && o);
-
-  pkey = ows_psql_id_column(o, layer_name); /* CAUTION: pkey could be NULL ! */
-
-  /* No Pkey display in GML (default behaviour) */
-  if (pkey && pkey->buf && !strcmp(prop_name, pkey->buf) && !o->expose_pk) return;
-
-  /* Avoid to expose elements from gml_exclude_items */
-  prop_name_buffer = buffer_from_str(prop_name);
+  assert(o && col && prefix && value);
 
-  if ((ows_layer_get(o->layers, layer_name))->exclude_items
-       && in_list(ows_layer_get(o->layers, layer_name)->exclude_items, prop_name_buffer)) return;
+  if (!*value) return; /* Don't display empty property */
 
-  buffer_free(prop_name_buffer);
+  if (col->gml_ns) fprintf(o->output, "   <gml:%s>", col->name);
+  else             fprintf(o->output, "   <%s:%s>", prefix->buf, col->name);
 
-  if (strlen(value) == 0) return; /* Don't display empty property */
+  col->type->encode(o->output, value);
 
-  /* We have to check if we use gml ns or not */
-  if ((ows_layer_get(o->layers, layer_name))->gml_ns
-      && (in_list_str((ows_layer_get(o->layers, layer_name))->gml_ns, prop_name))) gml_ns = true;
-
-  if (gml_ns) fprintf(o->output, "   <gml:%s>", prop_name);
-  else        fprintf(o->output, "   <%s:%s>", prefix->buf, prop_name);
-
-
-  /* PSQL date must be transformed into GML format */
-  if (    buffer_cmp(prop_type, "timestamptz")
-       || buffer_cmp(prop_type, "timestamp")
-       || buffer_cmp(prop_type, "datetime")
-       || buffer_cmp(prop_type, "date")) {
-    time = ows_psql_timestamp_to_xml_time(value);
-    fprintf(o->output, "%s", time->buf);
-    buffer_free(time);
+  if (col->gml_ns) fprintf(o->output, "</gml:%s>\n", col->name);
+  else             fprintf(o->output, "</%s:%s>\n", prefix->buf, col->name);
+}
 
-    /* PSQL boolean must be transformed into GML format */
-  } else if (buffer_cmp(prop_type, "bool")) {
-    if (!strcmp(value, "t")) fprintf(o->output, "true");
-    if (!strcmp(value, "f")) fprintf(o->output, "false");
 
-  } else if (    buffer_cmp(prop_type, "text")
-              || buffer_cmp(prop_type, "hstore")
-              || buffer_ncmp(prop_type, "char", 4)
-              || buffer_ncmp(prop_type, "varchar", 7)) {
+/*
+ * Decide once for all rows which columns are displayed, and how
+ * Return a vector of PQnfields() columns, to release with arena_release()
+ */
+static wfs_column *wfs_gml_columns(ows * o, buffer * layer_name, list * properties, PGresult * res)
+{
+  int j, nb_fields;
+  wfs_column *columns;
+  buffer *pkey;
+  ows_layer *l;
+  list *not_null;
+  char *name;
 
-    value_encoded = buffer_encode_xml_entities_str(value);
-    fprintf(o->output, "%s", value_encoded->buf);
-    buffer_free(value_encoded);
+  assert(o && layer_name && res);
 
-  } else fprintf(o->output, "%s", value);
+  l = ows_layer_get(o->layers, layer_name);
+  pkey = ows_psql_id_column(o, layer_name); /* CAUTION: pkey could be NULL ! */
+  not_null = ows_psql_not_null_properties(o, layer_name);
+  nb_fields = PQnfields(res);
+  columns = arena_malloc((nb_fields + 1) * sizeof(wfs_column));
+  assert(columns);
+
+  for (j = 0 ; j < nb_fields ; j++) {
+    name = PQfname(res, j);
+    columns[j].name = name;
+    columns[j].gml_ns = (l->gml_ns && in_list_str(l->gml_ns, name)) ? true : false;
+    columns[j].display =    !properties
+                         || in_list_str(properties, name)
+                         || buffer_cmp(properties->first->value, "*")
+                         || (not_null && in_list_str(not_null, name))
+                         || columns[j].gml_ns;
+
+    /* No Pkey display in GML (default behaviour) */
+    if (pkey && pkey->buf && !strcmp(name, pkey->buf) && !o->expose_pk) columns[j].display = false;
+
+    /* Avoid to expose elements from gml_exclude_items */
+    if (l->exclude_items && in_list_str(l->exclude_items, name)) columns[j].display = false;
+
+    columns[j].type = columns[j].display ? ows_psql_type_info_get(o, layer_name, name) : NULL;
+  }
 
-  if (gml_ns) fprintf(o->output, "</gml:%s>\n", prop_name);
-  else        fprintf(o->output, "</%s:%s>\n", prefix->buf, prop_name);
+  return columns;
 }
 
 
@@ -177,10 +167,13 @@ void wfs_gml_display_feature(ows * o, wfs_request * wr,
 void wfs_gml_feature_member(ows * o, wfs_request * wr, buffer * layer_name, list * properties, PGresult * res)
 {
   int i, j, number, end, nb_fields;
-  buffer *id_name, *ns_prefix, *prop_type, *layer;
-  array * describe;
+  buffer *id_name, *ns_prefix, *layer, *prefix;
+  wfs_column *columns;
+  double start;
   assert(o && wr && res && layer_name);
 
+  start = ows_time();
+
   /* CAUTION: Properties could be NULL ! */
 
   number = -1;
@@ -190,42 +183,36 @@ void wfs_gml_feature_member(ows * o, wfs_request * wr, buffer * layer_name, list
   if (id_name && id_name->use) number = PQfnumber(res, id_name->buf);
 
   ns_prefix = ows_layer_ns_prefix(o->layers, ows_layer_uri_to_prefix(o->layers, layer_name));
-  describe = ows_psql_describe_table(o, layer_name);
+  layer = ows_layer_no_uri(o->layers, layer_name);
+  prefix = ows_layer_uri_to_prefix(o->layers, layer_name);
+  columns = wfs_gml_columns(o, layer_name, properties, res);
+  nb_fields = PQnfields(res);
 
   /* display the results in gml */
   for (i = 0, end = PQntuples(res); i < end; i++) {
     fprintf(o->output, "  <gml:featureMember>\n");
 
-     layer = ows_layer_no_uri(o->layers, layer_name);
-
     /* print layer's name and id according to GML version */
     if (id_name && id_name->use) {
       if (wr->format == WFS_GML311)
         fprintf(o->output,  "   <%s gml:id=\"%s.%s\">\n",
-                ows_layer_uri_to_prefix(o->layers, layer_name)->buf,
-                layer->buf, PQgetvalue(res, i, number));
+                prefix->buf, layer->buf, PQgetvalue(res, i, number));
       else fprintf(o->output, "   <%s fid=\"%s.%s\">\n",
-                      ows_layer_uri_to_prefix(o->layers, layer_name)->buf,
-                      layer->buf, PQgetvalue(res, i, number));
-    } else fprintf(o->output,   "   <%s>\n", ows_layer_uri_to_prefix(o->layers, layer_name)->buf);
+                      prefix->buf, layer->buf, PQgetvalue(res, i, number));
+    } else fprintf(o->output,   "   <%s>\n", prefix->buf);
 
     /* print properties */
-    for (j = 0, nb_fields = PQnfields(res) ; j < nb_fields ; j++) {
-      if (    !properties
-           || in_list_str(properties, PQfname(res, j))
-           || buffer_cmp(properties->first->value, "*")
-           || (ows_psql_not_null_properties(o, layer_name)
-              && in_list_str(ows_psql_not_null_properties(o, layer_name), PQfname(res, j)))
-           || ((ows_layer_get(o->layers, layer_name))->gml_ns
-              && in_list_str((ows_layer_get(o->layers, layer_name))->gml_ns, PQfname(res, j)))) {
-        prop_type = array_get(describe, PQfname(res, j));
-        wfs_gml_display_feature(o, wr, layer_name, ns_prefix, PQfname(res,j), prop_type, PQgetvalue(res, i ,j));
-      }
-    }
+    for (j = 0 ; j < nb_fields ; j++)
+      if (columns[j].display)
+        wfs_gml_display_feature(o, &columns[j], ns_prefix, PQgetvalue(res, i ,j));
 
-    fprintf(o->output, "   </%s>\n", ows_layer_uri_to_prefix(o->layers, layer_name)->buf);
+    fprintf(o->output, "   </%s>\n", prefix->buf);
     fprintf(o->output, "  </gml:featureMember>\n");
   }
+
+  arena_release(columns);
+  o->timing.rows += end;
+  ows_timing_add(o, OWS_TIMING_RENDER, start);
 }
 
 
@@ -245,6 +232,7 @@ static void wfs_gml_display_namespaces(ows * o, wfs_request * wr)
   namespaces = ows_layer_list_namespaces(o->layers);
   assert(namespaces);
 
+  ows_timing_header(o);
   if (wr->format == WFS_GML212)
     fprintf(o->output, "Content-Type: text/xml; subtype=gml/2.1.2\n\n");
   else if (wr->format == WFS_GML311)
@@ -652,7 +640,9 @@ static mlist *wfs_retrieve_sql_request_list(ows * o, wfs_request * wr)
         buffer_add_str(where, " WHERE ");
 
         fe = filter_encoding_init();
-        fe = fe_filter(o, fe, layer_name, ln_filter->value);
+        if (wr->filter_node && wr->filter_node[cpt])
+          fe = fe_filter_node(o, fe, layer_name, wr->filter_node[cpt]);
+        else fe = fe_filter(o, fe, layer_name, ln_filter->value);
 
         if (fe->error_code != FE_NO_ERROR) {
           buffer_free(where);
@@ -761,19 +751,110 @@ static mlist *wfs_retrieve_sql_request_list(ows * o, wfs_request * wr)
 
 
 /*
- * Diplay in GeoJSON result of a GetFeature request
+ * Display in GeoJSON all features returned by the request on a layer
  */
-static void wfs_geojson_display_results(ows * o, wfs_request * wr, mlist * request_list)
+void wfs_geojson_feature_member(ows * o, buffer * layer_name, PGresult * res)
 {
-  PGresult *res;
-  list_node *ln, *ll;
   array *prop_table;
   array_node *an;
-  buffer *prop, *value_enc, *geom, *id_name;
+  buffer *prop, *geom, *id_name;
   bool first_row, first_col;
-  int i,j;
+  bool *is_geom;
+  int i, j;
   int geoms;
   int number;
+  double start;
+
+  assert(o && layer_name && res);
+
+  start = ows_time();
+  geom = buffer_init();
+  prop = buffer_init();
+  id_name = buffer_init();
+
+  prop_table = ows_psql_describe_table(o, layer_name);
+  first_row = true;
+  if(ows_psql_id_column(o, layer_name)) /* CAUTION: pkey could be NULL ! */
+    buffer_copy(id_name, ows_psql_id_column(o, layer_name));
+  number = -1;
+  if (id_name && id_name->use)
+       number = PQfnumber(res, id_name->buf);
+  buffer_empty(id_name);
+
+  /* Geometry columns are the same for all rows */
+  is_geom = arena_malloc((prop_table->size + 1) * sizeof(bool));
+  assert(is_geom);
+  for (an = prop_table->first, j=0 ; an ; an = an->next, j++)
+    is_geom[j] = ows_psql_is_geometry_column(o, layer_name, an->key);
+
+  for (i=0 ; i < PQntuples(res) ; i++) {
+
+    first_col = true;
+    geoms = 0;
+
+    if (first_row) first_row = false;
+    else fprintf(o->output, ",");
+
+    if ( number >= 0 ) {
+      buffer_add_str(id_name, "\"id\": \"");
+      buffer_copy(id_name, ows_layer_no_uri(o->layers, layer_name));
+      buffer_add_str(id_name, ".");
+      buffer_add_str(id_name, PQgetvalue(res, i, number));
+      buffer_add_str(id_name, "\", ");
+    }
+    for (an = prop_table->first, j=0 ; an ; an = an->next, j++) {
+      
+      if (is_geom[j]) {
+        buffer_add_str(geom, PQgetvalue(res, i, j));
+        geoms++;
+      } else {
+
+        if (first_col)  first_col = false;
+        else buffer_add_str(prop, ", \"");
+
+        buffer_copy(prop, an->key);
+        buffer_add_str(prop, "\": \"");
+        buffer_add_json_str(prop, PQgetvalue(res, i, j));
+        buffer_add(prop, '"');
+      }
+    }
+
+    if (geoms == 0) {
+      fprintf(o->output,
+              "{\"type\":\"Feature\", %s\"properties\":{\"%s}}\n",
+              id_name->buf, prop->buf);
+    } else if (geoms == 1) {
+      fprintf(o->output,
+              "{\"type\":\"Feature\", %s\"properties\":{\"%s}, \"geometry\":%s}\n",
+              id_name->buf, prop->buf, geom->buf);
+    } else if (geoms > 1) {
+      fprintf(o->output,
+              "{\"type\":\"Feature\", %s\"properties\":{\"%s}, \"geometry\":%s%s]}}\n",
+              id_name->buf,
+              prop->buf, "{ \"type\": \"GeometryCollection\", \"geometries\": [",
+              geom->buf);
+    }
+    buffer_empty(prop);
+    buffer_empty(geom);
+    buffer_empty(id_name);
+  }
+
+  arena_release(is_geom);
+  buffer_free(id_name);
+  buffer_free(geom);
+  buffer_free(prop);
+  o->timing.rows += PQntuples(res);
+  ows_timing_add(o, OWS_TIMING_RENDER, start);
+}
+
+
+/*
+ * Diplay in GeoJSON result of a GetFeature request
+ */
+static void wfs_geojson_display_results(ows * o, wfs_request * wr, mlist * request_list)
+{
+  PGresult *res;
+  list_node *ln, *ll;
 
   assert(o);
   assert(wr);
@@ -782,10 +863,8 @@ static void wfs_geojson_display_results(ows * o, wfs_request * wr, mlist * reque
   ln = ll= NULL;
 
   ll = request_list->first->next->value->first;
-  geom = buffer_init();
-  prop = buffer_init();
-  id_name = buffer_init();
 
+  ows_timing_header(o);
   if (wr->format == WFS_JSONP)
   {
          assert(wr->callback);
@@ -814,78 +893,13 @@ static void wfs_geojson_display_results(ows * o, wfs_request * wr, mlist * reque
       break;
     }
 
-    prop_table = ows_psql_describe_table(o, ll->value);
-    first_row = true;
-    if(ows_psql_id_column(o, ll->value)) /* CAUTION: pkey could be NULL ! */
-      buffer_copy(id_name, ows_psql_id_column(o, ll->value));
-    number = -1;
-    if (id_name && id_name->use)
-         number = PQfnumber(res, id_name->buf);
-    buffer_empty(id_name);
-
-    for (i=0 ; i < PQntuples(res) ; i++) {
-
-      first_col = true;
-      geoms = 0;
-
-      if (first_row) first_row = false;
-      else fprintf(o->output, ",");
-
-      if ( number >= 0 ) {
-        buffer_add_str(id_name, "\"id\": \"");
-        buffer_copy(id_name, ows_layer_no_uri(o->layers, ll->value));
-        buffer_add_str(id_name, ".");
-        buffer_add_str(id_name, PQgetvalue(res, i, number));
-        buffer_add_str(id_name, "\", ");
-      }
-      for (an = prop_table->first, j=0 ; an ; an = an->next, j++) {
-        
-        if (ows_psql_is_geometry_column(o, ll->value, an->key)) {
-          buffer_add_str(geom, PQgetvalue(res, i, j));
-          geoms++;
-        } else {
-
-          if (first_col)  first_col = false;
-          else buffer_add_str(prop, ", \"");
-
-          buffer_copy(prop, an->key);
-          buffer_add_str(prop, "\": \"");
-          value_enc = buffer_encode_json_str(PQgetvalue(res, i, j));
-          buffer_copy(prop, value_enc);
-          buffer_free(value_enc);
-          buffer_add(prop, '"');
-        }
-      }
-
-      if (geoms == 0) {
-        fprintf(o->output,
-                "{\"type\":\"Feature\", %s\"properties\":{\"%s}}\n",
-                id_name->buf, prop->buf);
-      } else if (geoms == 1) {
-        fprintf(o->output,
-                "{\"type\":\"Feature\", %s\"properties\":{\"%s}, \"geometry\":%s}\n",
-                id_name->buf, prop->buf, geom->buf);
-      } else if (geoms > 1) {
-        fprintf(o->output,
-                "{\"type\":\"Feature\", %s\"properties\":{\"%s}, \"geometry\":%s%s]}}\n",
-                id_name->buf,
-                prop->buf, "{ \"type\": \"GeometryCollection\", \"geometries\": [",
-                geom->buf);
-      }
-      buffer_empty(prop);
-      buffer_empty(geom);
-      buffer_empty(id_name);
-    }
-
+    wfs_geojson_feature_member(o, ll->value, res);
     PQclear(res);
     ll = ll->next;
   }
 
   fprintf(o->output, "]}");
   if (wr->format == WFS_JSONP) fprintf(o->output, ");");
-
-  buffer_free(geom);
-  buffer_free(prop);
 }
 
 
@@ -50,6 +50,7 @@ wfs_request *wfs_request_init()
   wr->maxfeatures = -1;
   wr->featureid = NULL;
   wr->filter = NULL;
+  wr->filter_node = NULL;
   wr->operation = NULL;
   wr->handle = NULL;
   wr->resulttype = NULL;
@@ -61,6 +62,17 @@ wfs_request *wfs_request_init()
   wr->delete_results = 0;
   wr->update_results = 0;
 
+  wr->transaction_sql = NULL;
+  wr->transaction_locator = NULL;
+  wr->transaction_set_layer = NULL;
+  wr->transaction_set_sql = NULL;
+  wr->transaction_set_values = NULL;
+  wr->transaction_set_end = NULL;
+  wr->transaction_set_ids = NULL;
+  wr->transaction_set_locator = NULL;
+  wr->transaction_reader = NULL;
+  wr->transaction_invalid = false;
+
   return wr;
 }
 
@@ -175,6 +187,7 @@ void wfs_request_free(wfs_request * wr)
   if (wr->srs)            ows_srs_free(wr->srs);
   if (wr->featureid)      mlist_free(wr->featureid);
   if (wr->filter)         list_free(wr->filter);
+  if (wr->filter_node)    free(wr->filter_node);
   if (wr->operation)      buffer_free(wr->operation);
   if (wr->handle)         list_free(wr->handle);
   if (wr->resulttype)     buffer_free(wr->resulttype);
@@ -183,6 +196,15 @@ void wfs_request_free(wfs_request * wr)
   if (wr->insert_results) alist_free(wr->insert_results);
   if (wr->callback)       buffer_free(wr->callback);
 
+  if (wr->transaction_sql)         list_free(wr->transaction_sql);
+  if (wr->transaction_locator)     list_free(wr->transaction_locator);
+  if (wr->transaction_set_layer)   buffer_free(wr->transaction_set_layer);
+  if (wr->transaction_set_sql)     buffer_free(wr->transaction_set_sql);
+  if (wr->transaction_set_values)  buffer_free(wr->transaction_set_values);
+  if (wr->transaction_set_end)     buffer_free(wr->transaction_set_end);
+  if (wr->transaction_set_ids)     list_free(wr->transaction_set_ids);
+  if (wr->transaction_set_locator) buffer_free(wr->transaction_set_locator);
+
   free(wr);
   wr = NULL;
 }
@@ -261,8 +283,8 @@ static list *wfs_request_check_typename(ows * o, wfs_request * wr, list * layer_
  */
 static list *wfs_request_check_fid(ows * o, wfs_request * wr, list * layer_name)
 {
-  list *fe, *ff;
-  mlist *f;
+  list *fe, *ff, *fids;
+  mlist *f, *merged;
   buffer *b, *layer;
   list_node *ln, *ln_tpn;
   mlist_node *mln = NULL;
@@ -355,6 +377,31 @@ static list *wfs_request_check_fid(ows * o, wfs_request * wr, list * layer_name)
     if (wr->typename) ln_tpn = ln_tpn->next;
   }
 
+  /* Without typename, featureid are merged by layer, following layer_name
+     order, so that each layer is then queried only once */
+  if (!wr->typename) {
+    merged = mlist_init();
+
+    for (ln_tpn = layer_name->first ; ln_tpn ; ln_tpn = ln_tpn->next) {
+      fids = list_init();
+
+      for (mln = f->first ; mln ; mln = mln->next)
+        for (ln = mln->value->first ; ln ; ln = ln->next) {
+          fe = list_split('.', ln->value, true);
+          ff = list_split(':', fe->last->value, false);
+          if (buffer_cmp(ows_layer_no_uri_to_uri(o->layers, ff->last->value), ln_tpn->value->buf))
+            list_add_by_copy(fids, ln->value);
+          list_free(ff);
+          list_free(fe);
+        }
+
+      mlist_add(merged, fids);
+    }
+
+    mlist_free(f);
+    f = merged;
+  }
+
   wr->featureid = f;
 
   return layer_name;
@@ -677,12 +724,28 @@ static void wfs_request_check_propertyname(ows * o, wfs_request * wr, list * lay
 }
 
 
+/*
+ * Check if a node is a given WFS (or FE) element of an XML request
+ */
+static bool wfs_request_is_wfs_node(xmlNodePtr n, const char *name)
+{
+  assert(n && name);
+
+  if (!n->ns || !n->ns->href || strcmp((char *) n->name, name)) return false;
+
+  return    !strcmp((char *) n->ns->href, "http://www.opengis.net/wfs")
+         || !strcmp((char *) n->ns->href, "http://www.opengis.net/ogc");
+}
+
+
 /*
  * Check and fill the filter parameter
  */
 static void wfs_request_check_filter(ows * o, wfs_request * wr)
 {
   buffer *b, *filter;
+  xmlNodePtr n, node;
+  unsigned int i;
   assert(o && wr);
 
   if (!array_is_key(o->cgi, "filter")) return; /* Filter is not mandatory */
@@ -697,6 +760,26 @@ static void wfs_request_check_filter(ows * o, wfs_request * wr)
               "Filter list size and typename list size must be similar", "GetFeature");
 
   buffer_free(filter);
+
+  /* XML request: Filter elements are taken from the request document,
+     in the same Query order than cgi_parse_xml */
+  if (o->exit || !o->request->doc) return;
+
+  wr->filter_node = malloc(sizeof(xmlNodePtr) * wr->filter->size);
+  assert(wr->filter_node);
+
+  n = xmlDocGetRootElement(o->request->doc)->children;
+  for (i = 0 ; n && i < wr->filter->size ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE || !wfs_request_is_wfs_node(n, "Query")) continue;
+
+    wr->filter_node[i] = NULL;
+    for (node = n->children ; node ; node = node->next)
+      if (node->type == XML_ELEMENT_NODE && wfs_request_is_wfs_node(node, "Filter"))
+        wr->filter_node[i] = node;
+    i++;
+  }
+
+  for ( /* empty */ ; i < wr->filter->size ; i++) wr->filter_node[i] = NULL;
 }
 
 
@@ -955,7 +1038,6 @@ void wfs_request_check(ows * o, wfs_request * wr, const array * cgi)
  */
 void wfs(ows * o, wfs_request * wf)
 {
-  buffer *op;
   assert(o && wf);
 
   /* Run the request's execution */
@@ -985,13 +1067,7 @@ void wfs(ows * o, wfs_request * wf)
         }
 
       } else {
-        if (array_is_key(o->cgi, "operations")) {
-          op = array_get(o->cgi, "operations");
-          wfs_parse_operation(o, wf, op);
-        } else {
-          ows_error(o, OWS_ERROR_INVALID_PARAMETER_VALUE, "Operation parameter must be set", "Transaction");
-          return;
-        }
+        wfs_parse_operation(o, wf, o->request->body);
       }
 
       break;
@@ -31,21 +31,27 @@
 #include "../ows/ows.h"
 
 /*
- * Execute the request sql matching a transaction
+ * Check the PostgreSQL result matching a transaction request
  * Return the result of the request (PGRES_COMMAND_OK or an error message)
  */
-static buffer *wfs_execute_transaction_request(ows * o, wfs_request * wr, buffer * sql)
+static buffer *wfs_transaction_request_result(ows * o, wfs_request * wr, PGresult * res)
 {
   buffer *result, *cmd_status;
-  PGresult *res;
 
   assert(o);
-  assert(sql);
+  assert(wr);
 
   result = buffer_init();
+
+  /* Connection lost before the result was received */
+  if (!res) {
+    buffer_add_str(result, PQerrorMessage(o->pg));
+    if (!result->use) buffer_add_str(result, "Transaction aborted");
+    return result;
+  }
+
   cmd_status = buffer_init();
 
-  res = ows_psql_exec(o, sql->buf);
   if (PQresultStatus(res) != PGRES_COMMAND_OK)
     buffer_add_str(result, PQresultErrorMessage(res));
   else
@@ -69,6 +75,235 @@ static buffer *wfs_execute_transaction_request(ows * o, wfs_request * wr, buffer
 }
 
 
+/*
+ * Execute the request sql matching a transaction
+ * Return the result of the request (PGRES_COMMAND_OK or an error message)
+ */
+static buffer *wfs_execute_transaction_request(ows * o, wfs_request * wr, buffer * sql)
+{
+  assert(o);
+  assert(sql);
+
+  return wfs_transaction_request_result(o, wr, ows_psql_exec(o, sql->buf));
+}
+
+
+/*
+ * Close the grouped Update/Delete statement, if any, and queue it
+ */
+static void wfs_transaction_set_close(ows * o, wfs_request * wr)
+{
+  buffer *sql;
+
+  assert(o);
+  assert(wr);
+
+  if (!wr->transaction_set_sql || !wr->transaction_set_sql->use) return;
+
+  sql = buffer_init();
+  buffer_copy(sql, wr->transaction_set_sql);
+
+  if (wr->transaction_set_end->use) {
+    buffer_copy(sql, wr->transaction_set_values);
+    buffer_copy(sql, wr->transaction_set_end);
+  } else fe_featureid_sql(o, sql, ows_psql_id_column(o, wr->transaction_set_layer),
+                          wr->transaction_set_ids);
+  buffer_add(sql, ';');
+
+  list_add(wr->transaction_sql, sql);
+  list_add_by_copy(wr->transaction_locator, wr->transaction_set_locator);
+
+  buffer_empty(wr->transaction_set_layer);
+  buffer_empty(wr->transaction_set_sql);
+  buffer_empty(wr->transaction_set_values);
+  buffer_empty(wr->transaction_set_end);
+  buffer_empty(wr->transaction_set_locator);
+  list_free(wr->transaction_set_ids);
+  wr->transaction_set_ids = list_init();
+}
+
+
+/*
+ * Send all queued transaction requests at once, and check their results
+ * in order. Stop on the first failed one and fill locator with its handle
+ * Return the result (PGRES_COMMAND_OK or an error message)
+ */
+static buffer *wfs_transaction_flush(ows * o, wfs_request * wr, buffer * locator)
+{
+  list_node *ln_sql, *ln_locator;
+  buffer *result;
+  PGresult *res;
+  int sent, i;
+
+  assert(o);
+  assert(wr);
+  assert(wr->transaction_sql);
+  assert(wr->transaction_locator);
+  assert(locator);
+
+  wfs_transaction_set_close(o, wr);
+
+  result = buffer_from_str("PGRES_COMMAND_OK");
+  if (!wr->transaction_sql->first) return result;
+
+  /* Without pipeline mode, fallback to a round trip per request */
+  sent = ows_psql_pipeline_begin(o, wr->transaction_sql);
+
+  for (i = 0, ln_sql = wr->transaction_sql->first, ln_locator = wr->transaction_locator->first ;
+       ln_sql ;
+       i++, ln_sql = ln_sql->next, ln_locator = ln_locator->next) {
+
+    /* A request not sent reports the connection error */
+    if (sent < 0)       res = ows_psql_exec(o, ln_sql->value->buf);
+    else if (i < sent)  res = ows_psql_pipeline_result(o);
+    else                res = NULL;
+
+    buffer_free(result);
+    result = wfs_transaction_request_result(o, wr, res);
+
+    if (!buffer_cmp(result, "PGRES_COMMAND_OK")) {
+      buffer_empty(locator);
+      buffer_copy(locator, ln_locator->value);
+      break;
+    }
+  }
+
+  if (sent >= 0) ows_psql_pipeline_end(o);
+
+  list_free(wr->transaction_sql);
+  list_free(wr->transaction_locator);
+  wr->transaction_sql = list_init();
+  wr->transaction_locator = list_init();
+
+  return result;
+}
+
+
+/*
+ * Queue a transaction request, to be sent later with others at once
+ * The queue is flushed when it becomes too large
+ * Return the result (PGRES_COMMAND_OK or an error message)
+ */
+static buffer *wfs_transaction_queue(ows * o, wfs_request * wr, buffer * sql, buffer * locator)
+{
+  assert(o);
+  assert(wr);
+  assert(sql);
+  assert(locator);
+
+  wfs_transaction_set_close(o, wr);
+
+  list_add_by_copy(wr->transaction_sql, sql);
+  list_add_by_copy(wr->transaction_locator, locator);
+
+  if (wr->transaction_sql->size >= WFS_TRANSACTION_QUEUE_MAX)
+    return wfs_transaction_flush(o, wr, locator);
+
+  return buffer_from_str("PGRES_COMMAND_OK");
+}
+
+
+/*
+ * Add an Update or Delete operation on a list of feature ids to the
+ * grouped statement, i.e a single DELETE ... WHERE pk = ANY(...) or
+ * UPDATE ... FROM (VALUES ...) for consecutive compatible operations
+ *
+ * Operations are compatible if they share the same statement head
+ * (same layer and, for Update, same properties) and don't touch twice
+ * the same feature. row is the Update VALUES content, NULL for Delete
+ * Return the result (PGRES_COMMAND_OK or an error message)
+ */
+static buffer *wfs_transaction_set_add(ows * o, wfs_request * wr, buffer * layer_name, buffer * head,
+                                       buffer * end, list * ids, buffer * row, buffer * locator)
+{
+  list_node *ln;
+  char *escaped;
+  bool close;
+
+  assert(o);
+  assert(wr);
+  assert(layer_name);
+  assert(head);
+  assert(end);
+  assert(ids);
+  assert(locator);
+
+  /* Nothing to do, as a WHERE FALSE */
+  if (!ids->first) return buffer_from_str("PGRES_COMMAND_OK");
+
+  close = !buffer_cmp(wr->transaction_set_sql, head->buf)
+          || wr->transaction_set_ids->size + ids->size > WFS_TRANSACTION_QUEUE_MAX;
+
+  for (ln = ids->first ; ln && !close ; ln = ln->next)
+    if (in_list(wr->transaction_set_ids, ln->value)) close = true;
+
+  if (close) wfs_transaction_set_close(o, wr);
+
+  if (!wr->transaction_set_sql->use) {
+    buffer_copy(wr->transaction_set_layer, layer_name);
+    buffer_copy(wr->transaction_set_sql, head);
+    buffer_copy(wr->transaction_set_end, end);
+    buffer_copy(wr->transaction_set_locator, locator);
+  }
+
+  for (ln = ids->first ; ln ; ln = ln->next) {
+    list_add_by_copy(wr->transaction_set_ids, ln->value);
+    if (!row) continue;
+
+    if (wr->transaction_set_values->use) buffer_add(wr->transaction_set_values, ',');
+    buffer_add_str(wr->transaction_set_values, "('");
+    escaped = ows_psql_escape_string(o, ln->value->buf);
+    if (escaped) {
+      buffer_add_str(wr->transaction_set_values, escaped);
+      free(escaped);
+    }
+    buffer_add(wr->transaction_set_values, '\'');
+    buffer_copy(wr->transaction_set_values, row);
+    buffer_add(wr->transaction_set_values, ')');
+  }
+
+  if (wr->transaction_sql->size >= WFS_TRANSACTION_QUEUE_MAX)
+    return wfs_transaction_flush(o, wr, locator);
+
+  return buffer_from_str("PGRES_COMMAND_OK");
+}
+
+
+/*
+ * Retrieve ids from a Filter made only of FeatureId (or GmlObjectId)
+ * elements, directly from the request tree: such filters are the most
+ * common ones in transactions, and don't need a Filter Encoding parse
+ * Return NULL if filter is something else, or on error (fe error code set)
+ */
+static list *wfs_transaction_filter_ids(ows * o, buffer * typename, xmlNodePtr filter, filter_encoding * fe)
+{
+  xmlNodePtr n, first;
+
+  assert(o);
+  assert(typename);
+  assert(filter);
+  assert(fe);
+
+  for (first = NULL, n = filter->children ; n ; n = n->next) {
+    if (n->type != XML_ELEMENT_NODE) continue;
+
+    if (!n->ns || strcmp((char *) n->ns->href, "http://www.opengis.net/ogc")) return NULL;
+
+    if (    strcmp((char *) n->name, "FeatureId")
+         && (strcmp((char *) n->name, "GmlObjectId") || ows_version_get(o->request->version) != 110))
+      return NULL;
+
+    /* Mixed identifiers, let Filter Encoding raise the error */
+    if (first && strcmp((char *) n->name, (char *) first->name)) return NULL;
+    if (!first) first = n;
+  }
+
+  if (!first) return NULL;
+
+  return fe_feature_id_list(o, typename, fe, first);
+}
+
+
 /*
  * Summarize overall results of transaction request
  */
@@ -198,6 +433,7 @@ static void wfs_transaction_response(ows * o, wfs_request * wr, buffer * result,
     return;
   }
 
+  ows_timing_header(o);
   fprintf(o->output, "Content-Type: application/xml\n\n");
   fprintf(o->output, "<?xml version='1.0' encoding='%s'?>\n", o->encoding->buf);
 
@@ -232,10 +468,104 @@ static void wfs_transaction_response(ows * o, wfs_request * wr, buffer * result,
 }
 
 
+/*
+ * Move the transaction reader to the next element sibling of the
+ * current one, or to its first element child if first is set
+ * Skipped subtrees are released by the reader
+ * Return NULL once the parent element is over
+ */
+static xmlNodePtr wfs_transaction_next(wfs_request * wr, bool first)
+{
+  xmlTextReaderPtr reader;
+  int depth, ret;
+
+  assert(wr);
+  assert(wr->transaction_reader);
+
+  reader = wr->transaction_reader;
+  depth = xmlTextReaderDepth(reader);
+
+  if (first) {
+    if (xmlTextReaderIsEmptyElement(reader)) return NULL;
+    depth++;
+    ret = xmlTextReaderRead(reader);
+  } else ret = xmlTextReaderNext(reader);
+
+  for ( /* empty */ ; ret == 1 ; ret = xmlTextReaderRead(reader)) {
+    if (xmlTextReaderDepth(reader) < depth) return NULL;
+    if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) break;
+  }
+
+  if (ret != 1) {
+    if (ret == -1) wr->transaction_invalid = true;
+    return NULL;
+  }
+
+  return xmlTextReaderCurrentNode(reader);
+}
+
+
+/*
+ * Build the whole subtree of the current transaction reader element
+ * and check it, as the document is validated while streamed
+ */
+static xmlNodePtr wfs_transaction_expand(ows * o, wfs_request * wr)
+{
+  xmlNodePtr n;
+
+  assert(o);
+  assert(wr);
+  assert(wr->transaction_reader);
+
+  n = xmlTextReaderExpand(wr->transaction_reader);
+
+  if (!n || (o->check_schema
+             && (   xmlTextReaderIsValid(wr->transaction_reader) != 1
+                 || !ows_libxml_check_namespace_element(o, n)))) {
+    wr->transaction_invalid = true;
+    return NULL;
+  }
+
+  return n;
+}
+
+
+/*
+ * Add a value to a COPY text format row, escaping special characters
+ */
+static void wfs_copy_add_value(buffer * row, const char *value)
+{
+  const char *p;
+
+  assert(row);
+  assert(value);
+
+  for (p = value ; *p ; p++) {
+    switch (*p) {
+      case '\\':
+        buffer_add_str(row, "\\\\");
+        break;
+      case '\t':
+        buffer_add_str(row, "\\t");
+        break;
+      case '\n':
+        buffer_add_str(row, "\\n");
+        break;
+      case '\r':
+        buffer_add_str(row, "\\r");
+        break;
+      default:
+        buffer_add(row, *p);
+    }
+  }
+}
+
+
 /*
  * Add a content node value to a buffer
+ * And if row is not NULL, also to a COPY text format row
  */
-static buffer *wfs_retrieve_value(ows * o, wfs_request * wr, buffer * value, xmlDocPtr xmldoc, xmlNodePtr n)
+static buffer *wfs_retrieve_value(ows * o, wfs_request * wr, buffer * value, buffer * row, xmlNodePtr n)
 {
   xmlChar *content;
   char *content_escaped;
@@ -251,7 +581,6 @@ static buffer *wfs_retrieve_value(ows * o, wfs_request * wr, buffer * value, xml
   if (!content_escaped) {
     xmlFree(content);
     buffer_free(value);
-    xmlFreeDoc(xmldoc);
     ows_error(o, OWS_ERROR_FORBIDDEN_CHARACTER,
               "Some forbidden character are present into the request", "transaction");
   }
@@ -260,6 +589,8 @@ static buffer *wfs_retrieve_value(ows * o, wfs_request * wr, buffer * value, xml
   buffer_add_str(value, content_escaped);
   buffer_add_str(value, "'");
 
+  if (row) wfs_copy_add_value(row, (char *) content);
+
   xmlFree(content);
   free(content_escaped);
 
@@ -310,30 +641,227 @@ static buffer *wfs_retrieve_typename(ows * o, wfs_request * wr, xmlNodePtr n)
 }
 
 
+/*
+ * Run a group of feature rows sharing the same layer and columns
+ *
+ * For a COPY group, a single row is queued as a plain INSERT request,
+ * several ones are streamed at once with COPY FROM STDIN
+ *
+ * Otherwise rows are inserted with a single multi-row INSERT request,
+ * group_end being then the id column DEFAULT value. As RETURNING order
+ * isn't guaranteed, ids are generated first by row ordinal in the same
+ * request, and each row takes its own, so related fids are completed
+ * by ordinal
+ */
+static buffer *wfs_insert_group(ows * o, wfs_request * wr, buffer * group_sql, buffer * group_data,
+                                buffer * group_end, int rows, buffer ** fids, buffer * insert_sql,
+                                buffer * locator)
+{
+  buffer *result, *sql;
+  PGresult *res;
+  int i, n;
+
+  assert(o);
+  assert(wr);
+  assert(group_sql);
+  assert(group_data);
+  assert(group_end);
+  assert(fids);
+  assert(insert_sql);
+  assert(locator);
+
+  if (buffer_ncmp(group_sql, "COPY", 4)) {
+    if (rows == 1) return wfs_transaction_queue(o, wr, insert_sql, locator);
+
+    /* COPY can't be pipelined, so queued requests have to be run first */
+    result = wfs_transaction_flush(o, wr, locator);
+    if (!buffer_cmp(result, "PGRES_COMMAND_OK")) return result;
+    buffer_free(result);
+
+    return wfs_transaction_request_result(o, wr, ows_psql_copy(o, group_sql->buf, group_data));
+  }
+
+  /* Generated ids are needed right now, so queued requests are run first */
+  result = wfs_transaction_flush(o, wr, locator);
+  if (!buffer_cmp(result, "PGRES_COMMAND_OK")) return result;
+
+  sql = buffer_init();
+  buffer_add_str(sql, "WITH \"ids\" AS (SELECT \"n\", ");
+  buffer_copy(sql, group_end);
+  buffer_add_str(sql, " AS \"id\" FROM generate_series(1, ");
+  buffer_add_int(sql, rows);
+  buffer_add_str(sql, ") AS \"n\"), \"inserted\" AS (");
+  buffer_copy(sql, group_sql);
+  buffer_copy(sql, group_data);
+  buffer_add_str(sql, ") SELECT \"n\", \"id\" FROM \"ids\"");
+
+  res = ows_psql_exec(o, sql->buf);
+  buffer_free(sql);
+
+  if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != rows) {
+    buffer_empty(result);
+    buffer_add_str(result, PQresultErrorMessage(res));
+    if (!result->use) buffer_add_str(result, "Unable to retrieve generated ids");
+    PQclear(res);
+    return result;
+  }
+
+  for (i = 0 ; i < rows ; i++) {
+    n = atoi(PQgetvalue(res, i, 0));
+
+    /* Each ordinal is expected once, on a fid still without id */
+    if (n < 1 || n > rows || fids[n - 1]->buf[fids[n - 1]->use - 1] != '.') {
+      buffer_empty(result);
+      buffer_add_str(result, "Unable to retrieve generated ids");
+      PQclear(res);
+      return result;
+    }
+
+    buffer_add_str(fids[n - 1], PQgetvalue(res, i, 1));
+  }
+  PQclear(res);
+
+  return result;
+}
+
+
+/*
+ * Insert a feature with ReplaceDuplicate idgen
+ * The given id is used, unless already used: nothing is then inserted
+ * by the first request, and the feature is inserted again with a new id
+ * Unlike a previous SELECT on the id, this is safe with concurrent transactions
+ * ON CONFLICT needs PostgreSQL 9.5 or later
+ * Return the result (PGRES_COMMAND_OK or an error message)
+ */
+static buffer *wfs_insert_replace_duplicate(ows * o, wfs_request * wr, buffer * layer_name,
+                                            buffer * insert, buffer * id, buffer * values,
+                                            buffer * fid_full_name, char * name, buffer * locator)
+{
+  buffer *result, *sql, *id_column, *new_id;
+  PGresult *res;
+  char *escaped;
+  int i;
+
+  assert(o);
+  assert(wr);
+  assert(layer_name);
+  assert(insert);
+  assert(id);
+  assert(values);
+  assert(fid_full_name);
+  assert(name);
+  assert(locator);
+
+  /* Result is needed right now, so queued requests are run first */
+  result = wfs_transaction_flush(o, wr, locator);
+  if (!buffer_cmp(result, "PGRES_COMMAND_OK")) return result;
+
+  id_column = ows_psql_id_column(o, layer_name);
+  sql = buffer_init();
+  new_id = NULL;
+
+  for (i = 0 ; i < 2 ; i++) {
+    buffer_empty(sql);
+    buffer_copy(sql, insert);
+
+    if (i == 0) {
+      buffer_add_str(sql, "('");
+      escaped = ows_psql_escape_string(o, id->buf);
+      if (escaped) {
+        buffer_add_str(sql, escaped);
+        free(escaped);
+      }
+      buffer_add_str(sql, "'");
+    } else if (ows_psql_id_default(o, layer_name)) {
+      buffer_add_str(sql, "(DEFAULT");
+    } else {
+      new_id = ows_psql_generate_id(o, layer_name);
+      buffer_add_str(sql, "('");
+      escaped = ows_psql_escape_string(o, new_id->buf);
+      if (escaped) {
+        buffer_add_str(sql, escaped);
+        free(escaped);
+      }
+      buffer_add_str(sql, "'");
+      buffer_free(new_id);
+    }
+
+    buffer_copy(sql, values);
+    buffer_add_str(sql, ")");
+    /* Only a conflict on the id is expected, others still fail */
+    if (i == 0) {
+      buffer_add_str(sql, " ON CONFLICT (\"");
+      buffer_copy(sql, id_column);
+      buffer_add_str(sql, "\") DO NOTHING");
+    }
+    buffer_add_str(sql, " RETURNING \"");
+    buffer_copy(sql, id_column);
+    buffer_add_str(sql, "\"");
+
+    res = ows_psql_exec(o, sql->buf);
+
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+      buffer_empty(result);
+      buffer_add_str(result, PQresultErrorMessage(res));
+      PQclear(res);
+      buffer_free(sql);
+      return result;
+    }
+
+    /* Feature inserted, report the id really used */
+    if (PQntuples(res) == 1) {
+      buffer_empty(fid_full_name);
+      buffer_add_str(fid_full_name, name);
+      buffer_add(fid_full_name, '.');
+      buffer_add_str(fid_full_name, PQgetvalue(res, 0, 0));
+      PQclear(res);
+      buffer_free(sql);
+      return result;
+    }
+
+    PQclear(res);
+  }
+
+  buffer_free(sql);
+  buffer_empty(result);
+  buffer_add_str(result, "Unable to insert feature with a new id");
+
+  return result;
+}
+
+
 /*
  * Insert features into the database
  * Method POST, XML
+ *
+ * Consecutive features sharing the same layer and columns are grouped:
+ * with a known id they are inserted with a single COPY request, with an
+ * id generated by PostgreSQL with a single multi-row INSERT request
  */
-static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNodePtr n)
+static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlNodePtr n, buffer * locator)
 {
-  buffer *values, *column, *layer_name, *layer_ns_prefix, *result, *sql, *gml;
-  buffer *handle, *id_column, *fid_full_name, *dup_sql, *id;
+  buffer *values, *column, *layer_name, *result, *sql, *gml;
+  buffer *handle, *id_column, *fid_full_name, *id;
+  buffer *columns, *row, *insert, *header, *end;
+  buffer *group_sql, *group_data, *group_end, *group_insert;
+  buffer *fids[WFS_TRANSACTION_QUEUE_MAX];
   xmlNodePtr node, elemt;
   filter_encoding *fe;
-  PGresult *res;
   array * table;
   char *escaped;
   list *l;
   ows_srs * srs_root;
   int srid_root = 0;
+  int group_rows = 0;
+  bool copy, generated, replace;
   xmlChar *attr = NULL;
   enum wfs_insert_idgen idgen = WFS_GENERATE_NEW;
   enum wfs_insert_idgen handle_idgen = WFS_GENERATE_NEW;
 
   assert(o);
   assert(wr);
-  assert(xmldoc);
   assert(n);
+  assert(locator);
 
   sql = buffer_init();
   handle = buffer_init();
@@ -383,14 +911,16 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
     attr = NULL;
   }
 
-  n = n->children;
-
-  /* jump to the next element if there are spaces */
-  while (n->type != XML_ELEMENT_NODE) n = n->next;
+  group_sql = buffer_init();
+  group_data = buffer_init();
+  group_end = buffer_init();
+  group_insert = buffer_init();
 
-  /* Create Insert SQL query for each Typename */
-  for ( /* Empty */ ; n ; n = n->next) {
-    if (n->type != XML_ELEMENT_NODE) continue;
+  /* Create Insert SQL query for each Typename
+     Features are streamed: each one is expanded in turn, and released
+     once the reader moves to the next one */
+  for (n = wfs_transaction_next(wr, true) ; n ; n = wfs_transaction_next(wr, false)) {
+    if (!(n = wfs_transaction_expand(o, wr))) break;
 
     id = buffer_init();
     values = buffer_init();
@@ -406,7 +936,12 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
       buffer_free(sql);
       buffer_free(values);
       buffer_free(handle);
+      buffer_free(group_sql);
+      buffer_free(group_data);
+      buffer_free(group_end);
+      buffer_free(group_insert);
       if (layer_name) buffer_free(layer_name);
+      if (result) buffer_free(result);
       result = buffer_from_str("Error unknown or not writable Layer Name");
       return result;
     }
@@ -424,6 +959,7 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
       buffer_empty(id);
       buffer_add_str(id, (char *) attr);
       xmlFree(attr);
+      attr = NULL;
     } else idgen = WFS_GENERATE_NEW;
     /* FIXME should we end on error if UseExisting or Replace without id set ? */
 
@@ -433,6 +969,11 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
       buffer_free(sql);
       buffer_free(values);
       buffer_free(layer_name);
+      buffer_free(group_sql);
+      buffer_free(group_data);
+      buffer_free(group_end);
+      buffer_free(group_insert);
+      if (result) buffer_free(result);
       result = buffer_from_str("Error unknown Layer Name or not id column available");
       return result;
     }
@@ -446,47 +987,24 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
       list_free(l);
     }
 
-    layer_ns_prefix = ows_layer_ns_prefix(o->layers, layer_name);
-
-    /* ReplaceDuplicate look if an ID is already used
-     *
-     * May not be safe if another transaction occur between
-     * this select and the related insert !!!
-     */
-    if (idgen == WFS_REPLACE_DUPLICATE) {
-      dup_sql = buffer_init();
-
-      buffer_add_str(dup_sql, "SELECT count(*) FROM \"");
-      buffer_copy(dup_sql, ows_psql_schema_name(o, layer_name));
-      buffer_add_str(dup_sql, "\".\"");
-      buffer_copy(dup_sql, ows_psql_table_name(o, layer_name));
-      buffer_add_str(dup_sql, "\" WHERE ");
-      buffer_copy(dup_sql, id_column);
-      buffer_add_str(dup_sql, "='");
-      escaped = ows_psql_escape_string(o, id->buf);
-      if (escaped) {
-        buffer_add_str(dup_sql, escaped);
-        free(escaped);
-      }
-      buffer_add_str(dup_sql, "';");
-
-      res = ows_psql_exec(o, dup_sql->buf);
-      if (PQresultStatus(res) != PGRES_TUPLES_OK || atoi((char *) PQgetvalue(res, 0, 0)) != 0)
-        idgen = WFS_GENERATE_NEW;
-      else
-        idgen = WFS_USE_EXISTING;
-
-      buffer_free(dup_sql);
-      PQclear(res);
-    }
+    /* ReplaceDuplicate use the given id, unless already used */
+    replace = (idgen == WFS_REPLACE_DUPLICATE);
+    if (replace) idgen = WFS_USE_EXISTING;
 
+    /* If the id column have a DEFAULT value, let PostgreSQL generate the id
+       and retrieve it later. Otherwise generate it now */
+    generated = false;
     if (idgen == WFS_GENERATE_NEW) {
       buffer_free(id);
-      id = ows_psql_generate_id(o, layer_name);
+      if (ows_psql_id_default(o, layer_name)) {
+        id = buffer_init();
+        generated = true;
+      } else id = ows_psql_generate_id(o, layer_name);
     }
 
     /* Retrieve the id of the inserted feature
      * to report it in transaction respons
+     * (generated one is completed once the INSERT is done)
      */
     fid_full_name = buffer_init();
     buffer_add_str(fid_full_name, (char *) n->name);
@@ -494,13 +1012,16 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
     buffer_copy(fid_full_name, id);
     alist_add(wr->insert_results, handle, fid_full_name);
 
-    buffer_add_str(sql, "INSERT INTO \"");
-    buffer_copy(sql, ows_psql_schema_name(o, layer_name));
-    buffer_add_str(sql, "\".\"");
-    buffer_copy(sql, ows_psql_table_name(o, layer_name));
-    buffer_add_str(sql, "\" (\"");
-    buffer_copy(sql, id_column);
-    buffer_add_str(sql, "\"");
+    columns = buffer_init();
+    buffer_add_str(columns, "\"");
+    buffer_copy(columns, id_column);
+    buffer_add_str(columns, "\"");
+
+    /* As 'id' could be NULL in GML */
+    row = buffer_init();
+    if (id->use) wfs_copy_add_value(row, id->buf);
+    else         buffer_add_str(row, "\\N");
+    copy = !generated;
 
     node = n->children;
 
@@ -523,18 +1044,19 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
           table = ows_psql_describe_table(o, layer_name);
           if (!array_is_key(table, (char *) node->name)) continue;
         }
-        buffer_add(sql, ',');
+        buffer_add(columns, ',');
         buffer_add(values, ',');
+        buffer_add(row, '\t');
 
         column = buffer_from_str((char *) node->name);
 
-        buffer_add_str(sql, "\"");
+        buffer_add_str(columns, "\"");
         escaped = ows_psql_escape_string(o, column->buf);
         if (escaped) {
-          buffer_add_str(sql, escaped);
+          buffer_add_str(columns, escaped);
           free(escaped);
         }
-        buffer_add_str(sql, "\"");
+        buffer_add_str(columns, "\"");
 
         /* If column's type is a geometry, transform the GML into WKT */
         if (ows_psql_is_geometry_column(o, layer_name, column)) {
@@ -549,17 +1071,27 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
               fe = filter_encoding_init();
               fe->sql = fe_envelope(o, layer_name, fe, fe->sql, elemt);
               if (fe->error_code != FE_NO_ERROR) {
+                if (result) buffer_free(result);
                 result = fill_fe_error(o, fe);
                 buffer_free(sql);
                 buffer_free(values);
                 buffer_free(column);
+                buffer_free(columns);
+                buffer_free(row);
                 buffer_free(id);
+                buffer_free(group_sql);
+                buffer_free(group_data);
+                buffer_free(group_end);
+                buffer_free(group_insert);
                 filter_encoding_free(fe);
                 return result;
               }
               buffer_copy(values, fe->sql);
               filter_encoding_free(fe);
 
+              /* Envelope is a SQL expression, not a raw value */
+              copy = false;
+
             } else if (!strcmp((char *) elemt->name, "Null")) {
               buffer_add_str(values, "''");
             } else {
@@ -568,57 +1100,207 @@ static buffer *wfs_insert_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
                 buffer_add_str(values, "'");
                 buffer_copy(values, gml);
                 buffer_add_str(values, "'");
+                buffer_copy(row, gml);
                 buffer_free(gml);
               } else {
                 buffer_free(sql);
                 buffer_free(values);
                 buffer_free(column);
+                buffer_free(columns);
+                buffer_free(row);
                 buffer_free(id);
                 buffer_free(layer_name);
+                buffer_free(group_sql);
+                buffer_free(group_data);
+                buffer_free(group_end);
+                buffer_free(group_insert);
 
+                if (result) buffer_free(result);
                 result = buffer_from_str("Error invalid Geometry");
                 return result;
               }
             }
-          }
-          else
+          } else {
             buffer_add_str(values, "NULL");
+            buffer_add_str(row, "\\N");
+          }
 
-        } else values = wfs_retrieve_value(o, wr, values, xmldoc, node);
+        } else values = wfs_retrieve_value(o, wr, values, row, node);
 
         buffer_free(column);
       }
     }
+    buffer_add(row, '\n');
 
-    /* As 'id' could be NULL in GML */
-    if (id->use) {
-      buffer_add_str(sql, ") VALUES ('");
+    /* Values of the current row: the given id (as 'id' could be NULL
+       in GML), a generated one is set when the row joins its group */
+    if (generated) /* nothing */ ;
+    else if (id->use) {
+      buffer_add_str(sql, "('");
       escaped = ows_psql_escape_string(o, id->buf);
       if (escaped) {
         buffer_add_str(sql, escaped);
         free(escaped);
       }
       buffer_add_str(sql, "'");
-    } else buffer_add_str(sql, ") VALUES (null");
+    } else buffer_add_str(sql, "(null");
 
     buffer_copy(sql, values);
-    buffer_add_str(sql, ") ");
+    buffer_add_str(sql, ")");
+
+    insert = buffer_init();
+    buffer_add_str(insert, "INSERT INTO \"");
+    buffer_copy(insert, ows_psql_schema_name(o, layer_name));
+    buffer_add_str(insert, "\".\"");
+    buffer_copy(insert, ows_psql_table_name(o, layer_name));
+    buffer_add_str(insert, "\" (");
+    buffer_copy(insert, columns);
+    buffer_add_str(insert, ") VALUES ");
+
+    if (replace) {
+      /* Run the current group first, to keep features order */
+      if (result) buffer_free(result);
+      result = NULL;
+      if (group_rows) {
+        result = wfs_insert_group(o, wr, group_sql, group_data, group_end,
+                                  group_rows, fids, group_insert, locator);
+        group_rows = 0;
+        buffer_empty(group_data);
+      }
+
+      if (!result || buffer_cmp(result, "PGRES_COMMAND_OK")) {
+        if (result) buffer_free(result);
+        result = wfs_insert_replace_duplicate(o, wr, layer_name, insert, id, values,
+                                              fid_full_name, (char *) n->name, locator);
+      }
+
+      buffer_free(insert);
+      buffer_free(columns);
+      buffer_free(values);
+      buffer_free(id);
+      buffer_free(layer_name);
+      buffer_free(row);
+      buffer_empty(sql);
 
+      if (!buffer_cmp(result, "PGRES_COMMAND_OK")) {
+        buffer_free(sql);
+        buffer_free(group_sql);
+        buffer_free(group_data);
+        buffer_free(group_end);
+        buffer_free(group_insert);
+        return result;
+      }
+
+      continue;
+    }
+
+    /* Group header: COPY request or multi-row INSERT request */
+    if (copy) {
+      header = buffer_init();
+      buffer_add_str(header, "COPY \"");
+      buffer_copy(header, ows_psql_schema_name(o, layer_name));
+      buffer_add_str(header, "\".\"");
+      buffer_copy(header, ows_psql_table_name(o, layer_name));
+      buffer_add_str(header, "\" (");
+      buffer_copy(header, columns);
+      buffer_add_str(header, ") FROM STDIN");
+    } else header = buffer_clone(insert);
+
+    end = buffer_init();
+    if (generated) buffer_copy(end, ows_psql_id_default(o, layer_name));
+
+    buffer_free(columns);
     buffer_free(values);
     buffer_free(id);
+    buffer_free(layer_name);
+
+    /* Run the current group if this feature can't join it */
+    if (group_rows && (   (!copy && !generated)
+                       || !buffer_cmp(group_sql, header->buf)
+                       || group_rows >= WFS_TRANSACTION_QUEUE_MAX)) {
+      if (result) buffer_free(result);
+      result = wfs_insert_group(o, wr, group_sql, group_data, group_end,
+                                group_rows, fids, group_insert, locator);
+      group_rows = 0;
+      buffer_empty(group_data);
+
+      if (!buffer_cmp(result, "PGRES_COMMAND_OK")) {
+        buffer_free(insert);
+        buffer_free(header);
+        buffer_free(end);
+        buffer_free(row);
+        buffer_free(sql);
+        buffer_free(group_sql);
+        buffer_free(group_data);
+        buffer_free(group_end);
+        buffer_free(group_insert);
+        return result;
+      }
+    }
+
+    if (copy || generated) {
+      /* Start a new group, keeping the first INSERT request
+         in case it stays alone */
+      if (!group_rows) {
+        buffer_empty(group_sql);
+        buffer_copy(group_sql, header);
+        buffer_empty(group_end);
+        buffer_copy(group_end, end);
+        buffer_empty(group_insert);
+        buffer_copy(group_insert, insert);
+        buffer_copy(group_insert, sql);
+      }
+
+      if (copy) buffer_copy(group_data, row);
+      else {
+        /* Id generated by the group request for this row ordinal */
+        if (group_rows) buffer_add(group_data, ',');
+        buffer_add_str(group_data, "((SELECT \"id\" FROM \"ids\" WHERE \"n\" = ");
+        buffer_add_int(group_data, group_rows + 1);
+        buffer_add(group_data, ')');
+        buffer_copy(group_data, sql);
+      }
+      fids[group_rows++] = fid_full_name;
+
+      if (!result) result = buffer_from_str("PGRES_COMMAND_OK");
+    } else {
+      /* Queue the request to insert the feature */
+      buffer_copy(insert, sql);
+      if (result) buffer_free(result);
+      result = wfs_transaction_queue(o, wr, insert, locator);
+    }
+
+    buffer_free(insert);
+    buffer_free(header);
+    buffer_free(end);
+    buffer_free(row);
+    buffer_empty(sql);
 
-    /* Run the request to insert each feature */
-    if(result) buffer_free(result);
-    result = wfs_execute_transaction_request(o, wr, sql);
     if (!buffer_cmp(result, "PGRES_COMMAND_OK")) {
       buffer_free(sql);
+      buffer_free(group_sql);
+      buffer_free(group_data);
+      buffer_free(group_end);
+      buffer_free(group_insert);
       return result;
     }
-    buffer_empty(sql);
-    buffer_free(layer_name);
   }
 
+  /* Run the last group */
+  if (group_rows) {
+    if (result) buffer_free(result);
+    result = wfs_insert_group(o, wr, group_sql, group_data, group_end,
+                              group_rows, fids, group_insert, locator);
+  }
+
+  /* No feature was run (none, or an invalid first one) */
+  if (!result) result = buffer_from_str("PGRES_COMMAND_OK");
+
   buffer_free(sql);
+  buffer_free(group_sql);
+  buffer_free(group_data);
+  buffer_free(group_end);
+  buffer_free(group_insert);
 
   return result;
 }
@@ -742,14 +1424,16 @@ void wfs_delete(ows * o, wfs_request * wr)
  * Delete features in database
  * Method POST / XML
  */
-static buffer *wfs_delete_xml(ows * o, wfs_request * wr, xmlNodePtr n)
+static buffer *wfs_delete_xml(ows * o, wfs_request * wr, xmlNodePtr n, buffer * locator)
 {
-  buffer *typename, *layer_name, *xmlstring, *result, *sql, *s, *t;
+  buffer *typename, *layer_name, *result, *sql, *s, *t, *end;
   filter_encoding *filter;
+  list *ids;
 
   assert(o);
   assert(wr);
   assert(n);
+  assert(locator);
 
   sql = buffer_init();
   s = t = NULL;
@@ -789,12 +1473,23 @@ static buffer *wfs_delete_xml(ows * o, wfs_request * wr, xmlNodePtr n)
   while (n->type != XML_ELEMENT_NODE) n = n->next;
   buffer_add_str(sql, " WHERE ");
 
-  /* put xml filter into a buffer */
-  xmlstring = buffer_init();
-  xmlstring = cgi_add_xml_into_buffer(xmlstring, n);
-
   filter = filter_encoding_init();
-  filter = fe_filter(o, filter, typename, xmlstring);
+
+  /* FeatureId filter: grouped with next Delete on the same layer */
+  ids = wfs_transaction_filter_ids(o, typename, n, filter);
+  if (ids) {
+    end = buffer_init();
+    result = wfs_transaction_set_add(o, wr, layer_name, sql, end, ids, NULL, locator);
+    buffer_free(end);
+    list_free(ids);
+    filter_encoding_free(filter);
+    buffer_free(typename);
+    buffer_free(sql);
+    return result;
+  }
+
+  if (filter->error_code == FE_NO_ERROR)
+    filter = fe_filter_node(o, filter, typename, n);
 
   /* check if filter returned an error */
   if (filter->error_code != FE_NO_ERROR)
@@ -802,12 +1497,11 @@ static buffer *wfs_delete_xml(ows * o, wfs_request * wr, xmlNodePtr n)
   else {
     buffer_copy(sql, filter->sql);
     buffer_add_str(sql, ";");
-    /* run the SQL request to delete all specified features */
-    result = wfs_execute_transaction_request(o, wr, sql);
+    /* queue the SQL request to delete all specified features */
+    result = wfs_transaction_queue(o, wr, sql, locator);
   }
 
   filter_encoding_free(filter);
-  buffer_free(xmlstring);
   buffer_free(typename);
   buffer_free(sql);
 
@@ -819,9 +1513,10 @@ static buffer *wfs_delete_xml(ows * o, wfs_request * wr, xmlNodePtr n)
  * Update features in database
  * Method POST / XML
  */
-static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNodePtr n)
+static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlNodePtr n, buffer * locator)
 {
-  buffer *typename, *layer_name, *xmlstring, *result, *sql, *property_name, *values, *gml, *s, *t;
+  buffer *typename, *layer_name, *result, *sql, *property_name, *values, *gml, *s, *t;
+  buffer *id_name, *head, *end, *row;
   filter_encoding *filter, *fe;
   xmlNodePtr node, elemt;
   xmlChar *content;
@@ -829,13 +1524,15 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
   array *table;
   ows_srs *srs_root;
   int srid_root = 0;
+  int columns = 0, i;
+  bool set = true;
   xmlChar *attr = NULL;
-  list *l;
+  list *l, *ids = NULL;
 
   assert(o);
   assert(wr);
-  assert(xmldoc);
   assert(n);
+  assert(locator);
 
   sql = buffer_init();
   content = NULL;
@@ -883,6 +1580,17 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
   buffer_copy(sql, t);
   buffer_add_str(sql, "\"");
 
+  /*
+   * When filtered on FeatureId, the update could be grouped with others
+   * in a single UPDATE ... FROM (VALUES ...) statement: head holds the
+   * statement with typed SET clause, row the new values
+   */
+  table = ows_psql_describe_table(o, layer_name);
+  head = buffer_init();
+  row = buffer_init();
+  buffer_copy(head, sql);
+  buffer_add_str(head, " SET ");
+
   n = n->children;
 
   /* jump to the next element if there are spaces */
@@ -904,7 +1612,6 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
            gml elements (name, description, boundedBy) */
         if (    !strcmp("http://www.opengis.net/gml", (char *) node->ns->href)
              || !strcmp("http://www.opengis.net/gml/3.2", (char *) node->ns->href)) {
-          table = ows_psql_describe_table(o, layer_name);
           if (!array_is_key(table, (char *) node->name)) continue;
         }
 
@@ -923,6 +1630,19 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
           escaped = ows_psql_escape_string(o, property_name->buf);
           if (escaped) {
             buffer_add_str(sql, escaped);
+
+            /* Grouped value is cast to column type, as VALUES are text */
+            if (array_is_key(table, property_name->buf)) {
+              if (columns) buffer_add(head, ',');
+              buffer_add(head, '"');
+              buffer_add_str(head, escaped);
+              buffer_add_str(head, "\" = ows_set.c");
+              buffer_add_int(head, columns++);
+              buffer_add_str(head, "::\"");
+              buffer_copy(head, array_get(table, property_name->buf));
+              buffer_add(head, '"');
+            } else set = false;
+
             free(escaped);
           }
           buffer_add_str(sql, "\"");
@@ -935,7 +1655,7 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
         if (node && node->type != XML_ELEMENT_NODE) node = node->next;
 
         /* replacement value is optional, set to NULL if not defined */
-        if (!node) buffer_add_str(sql, "NULL");
+        if (!node) buffer_add_str(values, "NULL");
         else if (!strcmp((char *) node->name, "Value")) {
           if (ows_psql_is_geometry_column(o, layer_name, property_name)) {
             elemt = node->children;
@@ -956,6 +1676,8 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
                 buffer_free(sql);
                 buffer_free(typename);
                 buffer_free(property_name);
+                buffer_free(head);
+                buffer_free(row);
                 filter_encoding_free(fe);
                 return result;
               }
@@ -963,6 +1685,9 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
               filter_encoding_free(fe);
               buffer_copy(values, fe->sql);
 
+              /* Envelope is a SQL expression, not a raw value */
+              set = false;
+
             } else if (!strcmp((char *) elemt->name, "Null")) {
               buffer_add_str(values, "''");
             } else {
@@ -977,40 +1702,46 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
                 buffer_free(typename);
                 buffer_free(property_name);
                 buffer_free(sql);
+                buffer_free(head);
+                buffer_free(row);
                 result = buffer_from_str("Invalid GML Geometry");
                 return result;
               }
             }
-          } else values = wfs_retrieve_value(o, wr, values, xmldoc, node);
-
-          buffer_copy(sql, values);
+          } else values = wfs_retrieve_value(o, wr, values, NULL, node);
         }
+
+        buffer_copy(sql, values);
+        buffer_add(row, ',');
+        buffer_copy(row, values);
         buffer_free(property_name);
       }
 
       if (!strcmp((char *) n->name, "Filter")) {
-        buffer_add_str(sql, " WHERE ");
-        xmlstring = buffer_init();
-        xmlstring = cgi_add_xml_into_buffer(xmlstring, n);
-
         filter = filter_encoding_init();
-        filter = fe_filter(o, filter, typename, xmlstring);
+
+        /* FeatureId filter: no need of Filter Encoding */
+        ids = wfs_transaction_filter_ids(o, typename, n, filter);
+
+        if (!ids && filter->error_code == FE_NO_ERROR) {
+          buffer_add_str(sql, " WHERE ");
+          filter = fe_filter_node(o, filter, typename, n);
+          buffer_copy(sql, filter->sql);
+        }
 
         /* check if filter returned an error */
         if (filter->error_code != FE_NO_ERROR) {
           result = fill_fe_error(o, filter);
-          buffer_free(xmlstring);
           filter_encoding_free(filter);
           buffer_free(values);
           buffer_free(sql);
           buffer_free(typename);
+          buffer_free(head);
+          buffer_free(row);
           return result;
-
-        } else {
-          buffer_copy(sql, filter->sql);
-          buffer_free(xmlstring);
-          filter_encoding_free(filter);
         }
+
+        filter_encoding_free(filter);
       }
     }
 
@@ -1019,104 +1750,227 @@ static buffer *wfs_update_xml(ows * o, wfs_request * wr, xmlDocPtr xmldoc, xmlNo
     buffer_free(values);
   }
 
-  buffer_add_str(sql, "; ");
-  /* run the request to update the specified features */
-  result = wfs_execute_transaction_request(o, wr, sql);
+  id_name = ows_psql_id_column(o, layer_name);
+
+  /* Grouped with next Update on the same layer and properties */
+  if (ids && set && columns && id_name && array_is_key(table, id_name->buf)) {
+    buffer_add_str(head, " FROM (VALUES ");
+
+    end = buffer_from_str(") AS ows_set(id");
+    for (i = 0 ; i < columns ; i++) {
+      buffer_add_str(end, ",c");
+      buffer_add_int(end, i);
+    }
+    buffer_add_str(end, ") WHERE \"");
+    buffer_copy(end, t);
+    buffer_add_str(end, "\".\"");
+    buffer_copy(end, id_name);
+    buffer_add_str(end, "\" = ows_set.id::\"");
+    buffer_copy(end, array_get(table, id_name->buf));
+    buffer_add(end, '"');
+
+    /* row is like: ,'value1','value2' */
+    result = wfs_transaction_set_add(o, wr, layer_name, head, end, ids, row, locator);
+    buffer_free(end);
+
+  } else {
+    if (ids) {
+      buffer_add_str(sql, " WHERE ");
+      if (ids->first) fe_featureid_sql(o, sql, id_name, ids);
+      else            buffer_add_str(sql, "FALSE");
+    }
+
+    buffer_add_str(sql, "; ");
+    /* queue the request to update the specified features */
+    result = wfs_transaction_queue(o, wr, sql, locator);
+  }
 
+  if (ids) list_free(ids);
   buffer_free(typename);
   buffer_free(sql);
+  buffer_free(head);
+  buffer_free(row);
 
   return result;
 }
 
 
+/*
+ * Log reader errors, either parsing or schema validity ones
+ */
+static void wfs_transaction_reader_error(void *arg, const char *msg, xmlParserSeverities severity,
+                                         xmlTextReaderLocatorPtr locator)
+{
+  ows_log((ows *) arg, 1, (char *) msg);
+}
+
+
 /*
  * Parse XML operations to execute each transaction operation
+ * Requests are queued and sent at once to PostgreSQL, so a whole
+ * transaction usually costs a single round trip
+ *
+ * The request is streamed with a reader, and validated on the fly:
+ * only the current operation (or the current feature of an Insert)
+ * is held in memory, whatever the request size
  */
-void wfs_parse_operation(ows * o, wfs_request * wr, buffer * op)
+void wfs_parse_operation(ows * o, wfs_request * wr, const char * query)
 {
-  xmlDocPtr xmldoc;
+  xmlTextReaderPtr reader;
+  xmlSchemaPtr schema;
   xmlNodePtr n;
   xmlAttr *att;
   xmlChar *content;
+  char *error = NULL;
+  int ret, operations = 0;
+  double start;
 
   buffer *sql, *result, *end_transaction, *locator;
 
   assert(o);
   assert(wr);
-  assert(op);
+  assert(query);
 
-  sql = buffer_init();
-  locator = buffer_init();
-  wr->insert_results = alist_init();
-  content = NULL;
+  reader = xmlReaderForMemory(query, strlen(query), NULL, NULL, 0);
+  if (!reader) {
+    wfs_error(o, wr, WFS_ERROR_NO_MATCHING, "xml isn't valid", "transaction");
+    return;
+  }
+
+  xmlTextReaderSetErrorHandler(reader, wfs_transaction_reader_error, (void *) o);
+
+  if (o->check_schema) {
+    start = ows_time();
+    schema = ows_schema_wfs(o, o->request->version);
+    ows_timing_add(o, OWS_TIMING_SCHEMA, start);
+    if (!schema || xmlTextReaderSetSchema(reader, schema)) {
+      xmlFreeTextReader(reader);
+      ows_error(o, OWS_ERROR_INVALID_PARAMETER_VALUE, "XML request isn't valid", "request");
+      return;
+    }
+  }
 
-  xmldoc = xmlParseMemory(op->buf, op->use);
+  /* Root element, operations are its children */
+  while ((ret = xmlTextReaderRead(reader)) == 1
+         && xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT);
 
-  if (!xmldoc) {
-    xmlFreeDoc(xmldoc);
+  if (ret != 1) {
+    xmlFreeTextReader(reader);
     wfs_error(o, wr, WFS_ERROR_NO_MATCHING, "xml isn't valid", "transaction");
     return;
   }
 
-  /* jump to the next element if there are spaces */
-  n = xmldoc->children;
-  while (n->type != XML_ELEMENT_NODE) n = n->next;
-  n = n->children;
-  while (n->type != XML_ELEMENT_NODE) n = n->next; /* FIXME really ? */
+  sql = buffer_init();
+  locator = buffer_init();
+  wr->insert_results = alist_init();
+  wr->transaction_sql = list_init();
+  wr->transaction_locator = list_init();
+  wr->transaction_set_layer = buffer_init();
+  wr->transaction_set_sql = buffer_init();
+  wr->transaction_set_values = buffer_init();
+  wr->transaction_set_end = buffer_init();
+  wr->transaction_set_ids = list_init();
+  wr->transaction_set_locator = buffer_init();
+  wr->transaction_reader = reader;
+  wr->transaction_invalid = false;
+  content = NULL;
 
   /* initialize the transaction inside postgresql */
   buffer_add_str(sql, "BEGIN;");
-  result = wfs_execute_transaction_request(o, wr, sql);
-
-  buffer_empty(result);
-  buffer_add_str(result, "PGRES_COMMAND_OK");
+  buffer_add_str(locator, "transaction");
+  result = wfs_transaction_queue(o, wr, sql, locator);
   buffer_empty(sql);
 
   /* go through the operations while transaction is successful */
-  for ( /* empty */ ; n && (buffer_cmp(result, "PGRES_COMMAND_OK")) ; n = n->next) {
-    if (n->type != XML_ELEMENT_NODE) continue;
+  for (n = wfs_transaction_next(wr, true) ;
+       n && buffer_cmp(result, "PGRES_COMMAND_OK") ;
+       n = wfs_transaction_next(wr, false)) {
+
+    if (!n->ns || !n->ns->href
+        || (    strcmp((char *) n->ns->href, "http://www.opengis.net/wfs")
+             && strcmp((char *) n->ns->href, "http://www.opengis.net/ogc"))) continue;
+
+    if (!strcmp((char *) n->name, "LockID")) {
+      error = "LockID is not implemented";
+      break;
+    } else if (    strcmp((char *) n->name, "Insert")
+                && strcmp((char *) n->name, "Delete")
+                && strcmp((char *) n->name, "Update")) {
+      error = "Unknown or invalid Query";
+      break;
+    }
+
+    operations++;
+
+    /* fill locator with handle attribute if specified
+       else with transaction name */
+    buffer_empty(locator);
+    if (n->properties) {
+      att = n->properties;
+
+      if (!strcmp((char *) att->name, "handle")) {
+        content = xmlNodeGetContent(att->children);
+        buffer_add_str(locator, (char *) content);
+        xmlFree(content);
+      } else buffer_add_str(locator, (char *) n->name);
+    } else     buffer_add_str(locator, (char *) n->name);
+
+    /* Insert streams its features, others are small enough to be expanded */
+    if (strcmp((char *) n->name, "Insert") && !(n = wfs_transaction_expand(o, wr))) break;
 
     if (!strcmp((char *) n->name, "Insert")) {
       buffer_free(result);
-      result = wfs_insert_xml(o, wr, xmldoc, n);
+      result = wfs_insert_xml(o, wr, n, locator);
     } else if (!strcmp((char *) n->name, "Delete")) {
       buffer_free(result);
-      result = wfs_delete_xml(o, wr, n);
+      result = wfs_delete_xml(o, wr, n, locator);
     } else if (!strcmp((char *) n->name, "Update")) {
       buffer_free(result);
-      result = wfs_update_xml(o, wr, xmldoc, n);
+      result = wfs_update_xml(o, wr, n, locator);
     }
 
-    /* fill locator only if transaction failed */
-    if (!buffer_cmp(result, "PGRES_COMMAND_OK")) {
-      /* fill locator with  handle attribute if specified
-         else with transaction name */
-      if (n->properties) {
-        att = n->properties;
-
-        if (!strcmp((char *) att->name, "handle")) {
-          content = xmlNodeGetContent(att->children);
-          buffer_add_str(locator, (char *) content);
-          xmlFree(content);
-        } else buffer_add_str(locator, (char *) n->name);
-      } else     buffer_add_str(locator, (char *) n->name);
-    }
+    if (wr->transaction_invalid) break;
   }
 
-  /* end the transaction according to the result */
-  if (buffer_cmp(result, "PGRES_COMMAND_OK")) buffer_add_str(sql, "COMMIT;");
-  else                                        buffer_add_str(sql, "ROLLBACK;");
+  /* the whole request have to be read, to be sure it is valid */
+  if (!error && !wr->transaction_invalid && buffer_cmp(result, "PGRES_COMMAND_OK")) {
+    while ((ret = xmlTextReaderRead(reader)) == 1);
+    if (ret == -1 || (o->check_schema && xmlTextReaderIsValid(reader) != 1))
+      wr->transaction_invalid = true;
+  }
+
+  if (!error && wr->transaction_invalid) error = "XML request isn't valid";
+  if (!error && !operations) error = "Operation parameter must be set";
 
-  end_transaction = wfs_execute_transaction_request(o, wr, sql);
-  buffer_free(end_transaction);
+  /* send remaining requests, and commit if all were successful */
+  if (!error && buffer_cmp(result, "PGRES_COMMAND_OK")) {
+    buffer_empty(locator);
+    buffer_add_str(locator, "transaction");
+    buffer_add_str(sql, "COMMIT;");
+    wfs_transaction_set_close(o, wr);
+    list_add_by_copy(wr->transaction_sql, sql);
+    list_add_by_copy(wr->transaction_locator, locator);
+
+    buffer_free(result);
+    result = wfs_transaction_flush(o, wr, locator);
+  }
+
+  /* a failed request let the transaction open, in an aborted state */
+  if (error || !buffer_cmp(result, "PGRES_COMMAND_OK")) {
+    buffer_empty(sql);
+    buffer_add_str(sql, "ROLLBACK;");
+    end_transaction = wfs_execute_transaction_request(o, wr, sql);
+    buffer_free(end_transaction);
+  }
 
   /* display the xml transaction response */
-  wfs_transaction_response(o, wr, result, locator);
+  if (error) ows_error(o, OWS_ERROR_INVALID_PARAMETER_VALUE, error, "request");
+  else wfs_transaction_response(o, wr, result, locator);
 
   buffer_free(sql);
   buffer_free(result);
   buffer_free(locator);
 
-  xmlFreeDoc(xmldoc);
+  wr->transaction_reader = NULL;
+  xmlFreeTextReader(reader);
 }